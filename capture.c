@@ -0,0 +1,458 @@
+//------------------------------------------------------------------------
+// capture.c - Pinger triggers, the capture queue filled by the ISRs,
+//             echo pairing and crosstalk, and the ping rate scheduler.
+//------------------------------------------------------------------------
+#include "capture.h"
+#include "ranging.h"
+#include "steer_params.h"
+#include "profile.h"
+
+#define CROSSTALK_GUARD_CYCLES US_CYCLES(150) // Echoes ending this close are one sound
+#define CROSSTALK_SHORT_MM 50         // and this much short of our range, not ours
+
+// PING TIMING (ticks) //
+#define PING_STAGGER_TICKS 4          // Min time between any two triggers
+#define ECHO_TIMEOUT_TICKS 30         // Echo lost if not ended by then
+#define ECHO_STALE_TICKS 100          // No echo for this long: range is stale
+#define ECHO_SETTLE_TICKS 6           // Quiet time after an echo before re-firing
+#define PING_WINDOW_TICKS 120         // Trigger slots are shared out per window
+#define PING_SLOTS (PING_WINDOW_TICKS / PING_STAGGER_TICKS) // All the stagger allows
+#define PING_MIN_SLOTS 4              // Every pinger fires at least every 30 ticks
+
+// PING RATE DEMAND //
+#define PING_BASE_WEIGHT 64           // Demand of a pinger with nothing to watch
+#define FRONT_WATCH_MM 1500           // Front demand grows as the range nears 0
+                                      // from here...
+#define FRONT_LOOKAHEAD_TICKS 250     // ...taking the closing speed over this
+#define WALL_ERR_WATCH_MM 256         // Left demand stops growing at this error
+#define WALL_ERR_WEIGHT 4             // Demand per mm of wall error
+
+volatile uint16_t pulse_count[3];      //Global Pulse Count
+volatile uint32_t fallingEdge[3];
+volatile uint32_t risingEdge[3];
+volatile uint32_t cycles[3];          //Echo width (SMCLK cycles)
+volatile uint8_t edge[3];             //1 while a rising edge awaits its fall
+volatile uint8_t waiting;             // Bit per pinger awaiting its echo
+volatile uint8_t echoReady;           // Bit per pinger with an unprocessed echo
+volatile uint8_t echoTimer[3];        // Ticks left before the echo is lost
+volatile uint16_t nextPingTick[3];    // Earliest tick to fire each pinger
+uint16_t lastPingTick[3];             // tickCount of each pinger's last trigger
+uint8_t pingSlots[3];                 // Its share of the PING_SLOTS per window
+uint8_t pingPeriod[3];                // Ticks wanted between its triggers
+volatile uint16_t echoTimeoutCount[3]; // Echoes lost per pinger
+volatile uint16_t echoTick[3];        // tickCount of each pinger's last echo
+uint8_t pinger_sel;
+uint16_t lastTriggerTick;
+
+// CROSSTALK VARIABLES //
+volatile uint8_t pingSeq;             // Count of triggers sent
+volatile uint8_t triggerSeq[3];       // pingSeq of each pinger's last trigger
+volatile uint8_t echoSeq[3];          // triggerSeq when the last echo ended
+volatile uint16_t crosstalkCount[3];  // Echoes rejected as crosstalk
+
+// CAPTURE QUEUE //
+#define CAPTURE_QUEUE_SIZE 16         // Must be a power of two
+#define CAPTURE_QUEUE_MASK (CAPTURE_QUEUE_SIZE - 1)
+
+typedef struct
+{
+  uint32_t time;                      // Extended capture timestamp
+  uint8_t ping_num;                   // Pinger the capture belongs to
+  uint8_t flags;                      // CAPTURE_RISING | CAPTURE_OVERRUN
+} CaptureEvent;
+
+//filled by the capture ISRs (never nested, so one producer) and
+//drained by DistanceTask
+CaptureEvent captureQueue[CAPTURE_QUEUE_SIZE];
+volatile uint8_t captureHead;         // Next free slot, written by ISRs
+volatile uint8_t captureTail;         // Next event to process, written by main
+volatile uint8_t captureDepthMax;     // High-water mark of queued events
+volatile uint16_t captureDropCount;   // Events lost on a full queue
+volatile uint16_t covCount[3];        // Capture overruns per pinger
+
+uint32_t ExtendCapture( uint16_t high, uint16_t ccr_val, uint8_t ovf_pending )
+//------------------------------------------------------------------------
+// Func:  Build a 32-bit timestamp from a 16-bit capture and the overflow
+//        count. If the timer wrapped but its overflow IRQ has not run
+//        yet, a capture from the low half of the range was taken after
+//        the wrap and belongs to the next count. Called by the board's
+//        capture ISRs; kept here so host/test_capture.c can run the
+//        wrap cases the host's 64-bit clock never reaches.
+// Args:  high = overflow count, ccr_val = captured timer value,
+//        ovf_pending = TAIFG/TBIFG still set
+// Retn:  the extended timestamp
+//------------------------------------------------------------------------
+{
+  if (ovf_pending && ccr_val < 0x8000)
+  {
+    high++;
+  }
+  return ((uint32_t)high << 16) | ccr_val;
+}
+
+uint8_t CaptureTick(void)
+//------------------------------------------------------------------------
+// Func:  Give up on echoes that never ended, so the pinger may fire
+//        again, and retry echoes left waiting for a possible crosstalk
+//        partner. A lost echo leaves pinger[] as it was, but EchoFresh
+//        stops vouching for it. Called by SchedulerTick from the tick IRQ.
+// Args:  None
+// Retn:  1 if the main loop must be woken, else 0
+//------------------------------------------------------------------------
+{
+  uint8_t t;
+  uint8_t wake = 0;
+  
+  for (t = 0; t < NUM_PINGERS; t++)
+  {
+    if (echoTimer[t] != 0 && --echoTimer[t] == 0 && (waiting & (1 << t)))
+    {
+      waiting &= ~(1 << t);
+      echoTimeoutCount[t]++;
+      nextPingTick[t] = tickCount;
+      
+      //keep a stale echo stale across a tickCount wrap
+      if ((uint16_t)(tickCount - echoTick[t]) > ECHO_STALE_TICKS)
+      {
+        echoTick[t] = tickCount - ECHO_STALE_TICKS - 1;
+      }
+      wake = 1;
+    }
+  }
+  
+  if (echoReady != 0)
+  {
+    SchedulerRelease(DISTANCE_TASK);
+    wake = 1;
+  }
+  return wake;
+}
+
+void CapturePush( uint8_t ping_num, uint8_t flags, uint32_t time )
+//------------------------------------------------------------------------
+// Func:  Queue a capture for the main loop, called from the capture ISRs
+// Args:  ping_num = pinger the capture belongs to
+//        flags = CAPTURE_RISING | CAPTURE_OVERRUN
+//        time = extended capture timestamp
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint8_t next = (captureHead + 1) & CAPTURE_QUEUE_MASK;
+  uint8_t depth;
+  
+  if (next == captureTail)
+  {
+    captureDropCount++;
+    return;
+  }
+  
+  captureQueue[captureHead].time = time;
+  captureQueue[captureHead].ping_num = ping_num;
+  captureQueue[captureHead].flags = flags;
+  captureHead = next;                   // Publish the filled slot
+  
+  depth = (captureHead - captureTail) & CAPTURE_QUEUE_MASK;
+  if (depth > captureDepthMax)
+  {
+    captureDepthMax = depth;
+  }
+  
+  SchedulerRelease(DISTANCE_TASK);
+}
+
+void TimerReadPinger( CaptureEvent *event )
+//------------------------------------------------------------------------
+// Func:  Process a queued capture edge, on the falling edge of an
+//        awaited echo mark the measurement complete
+// Args:  event = the capture taken by the ISR
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint8_t ping_num = event->ping_num;
+  PROFILE_START(PROFILE_TIMER_READ);
+  
+  //increase the count of total echos we've seen
+  pulse_count[ping_num] += 1;
+  
+  //an edge was lost, so this one can't be paired with the last
+  if (event->flags & CAPTURE_OVERRUN)
+  {
+    covCount[ping_num]++;
+    edge[ping_num] = 0;
+  }
+   
+  //rising edge
+  if (event->flags & CAPTURE_RISING)
+  {
+    risingEdge[ping_num] = event->time;
+    edge[ping_num] = 1;
+  }
+  //falling edge of a pulse whose rise we saw
+  else if (edge[ping_num])
+  {
+    fallingEdge[ping_num] = event->time;
+    //both edges are 32-bit, so this is right across any timer wrap
+    cycles[ping_num] = fallingEdge[ping_num] - risingEdge[ping_num];
+    edge[ping_num] = 0;
+    
+    //only an echo we are still waiting on is a new measurement
+    HalDisableIrq();
+    if (waiting & (1 << ping_num))
+    {
+      waiting &= ~(1 << ping_num);
+      echoReady |= 1 << ping_num;
+      echoSeq[ping_num] = triggerSeq[ping_num];
+      echoTick[ping_num] = tickCount;
+      nextPingTick[ping_num] = tickCount + ECHO_SETTLE_TICKS;
+    }
+    HalEnableIrq();
+  }
+  PROFILE_STOP(PROFILE_TIMER_READ);
+}
+
+void ProcessCaptures(void)
+{
+  while (captureTail != captureHead)
+  {
+    TimerReadPinger(&captureQueue[captureTail]);
+    captureTail = (captureTail + 1) & CAPTURE_QUEUE_MASK;
+  }
+}
+
+uint8_t IsCrosstalk( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Check if a pinger's echo was ended by another pinger's sound.
+//        A wavefront heard by two pingers ends both echoes at the same
+//        time, and only the pinger that was triggered first owns it.
+//        The other's echo then ends before its own sound could have
+//        come back, so an echo that agrees with the pinger's last range
+//        is kept even if it ends with another one.
+// Args:  ping_num = the pinger whose latest echo is being checked
+// Retn:  1 if the echo should be rejected, else 0
+//------------------------------------------------------------------------
+{
+  uint8_t j;
+  uint32_t gap;
+  
+  if (pinger[ping_num] != 0 &&
+      WidthToMm(EchoWidthUs(ping_num)) + CROSSTALK_SHORT_MM >= pinger[ping_num])
+  {
+    return 0;
+  }
+  
+  for (j = 0; j < NUM_PINGERS; j++)
+  {
+    //only echoes of pingers fired before this one that have ended
+    if (j == ping_num || triggerSeq[j] == 0 || echoSeq[j] != triggerSeq[j] ||
+        (int8_t)(triggerSeq[ping_num] - triggerSeq[j]) <= 0)
+    {
+      continue;
+    }
+    
+    gap = fallingEdge[ping_num] - fallingEdge[j];
+    if (gap < CROSSTALK_GUARD_CYCLES || (uint32_t)-gap < CROSSTALK_GUARD_CYCLES)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void TriggerPinger( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Fire a pinger. The board times the trigger pulse in hardware,
+//        this only arms the echo capture and asks for the pulse.
+// Args:  ping_num = the pinger to start
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  if (++pingSeq == 0)
+  {
+    pingSeq = 1;                              // 0 marks a pinger never fired
+  }
+  triggerSeq[ping_num] = pingSeq;
+  
+  HalDisableIrq();
+  edge[ping_num] = 0;                         // Next edge is the rising one
+  echoTimer[ping_num] = ECHO_TIMEOUT_TICKS;
+  waiting |= 1 << ping_num;
+  HalTriggerPulse(ping_num);
+  HalEnableIrq();
+}
+
+uint8_t EchoSettled( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Check that an echo ended long enough ago for any crosstalk
+//        partner to have been captured too
+// Args:  ping_num = the pinger to check
+// Retn:  1 if the echo can be judged, else 0
+//------------------------------------------------------------------------
+{
+  uint16_t now = HalCaptureTimer(ping_num);
+  return (uint16_t)(now - (uint16_t)fallingEdge[ping_num]) >= CROSSTALK_GUARD_CYCLES;
+}
+
+uint8_t EchoFresh( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Check that a pinger's range is backed by a recent echo. Open
+//        space gives no echo at all (or one longer than the timeout),
+//        which must not leave the last obstacle standing in pinger[].
+//        One lost echo in between is forgiven.
+// Args:  ping_num = the pinger to check
+// Retn:  1 if an echo ended within ECHO_STALE_TICKS, else 0
+//------------------------------------------------------------------------
+{
+  return (uint16_t)(tickCount - echoTick[ping_num]) <= ECHO_STALE_TICKS;
+}
+
+uint8_t TakeEcho( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Claim a pinger's completed echo for processing
+// Args:  ping_num = the pinger to check
+// Retn:  1 if an unprocessed echo was waiting, else 0
+//------------------------------------------------------------------------
+{
+  uint8_t ready = echoReady & (1 << ping_num);
+  
+  echoReady &= ~(1 << ping_num);
+  return ready != 0;
+}
+
+void PingRates(void)
+//------------------------------------------------------------------------
+// Func:  Share the PING_SLOTS triggers of a window out by demand and set
+//        each pinger's period from its share. The front asks for more
+//        as the range it will have in FRONT_LOOKAHEAD_TICKS shrinks,
+//        the left as the wall error grows, and the right follows the
+//        front at half weight, as only a dodge reads it.
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint16_t weight[3];
+  uint16_t total;
+  int32_t ahead;
+  int16_t err;
+  uint8_t spare;
+  uint8_t n;
+  
+  //no reading yet counts as the most urgent
+  ahead = 0;
+  if (pinger[0] != 0)
+  {
+    ahead = pinger[0];
+    if (pingerRate[0] < 0)
+    {
+      ahead += ((int32_t)pingerRate[0] * FRONT_LOOKAHEAD_TICKS) >> 8;
+    }
+  }
+  weight[0] = PING_BASE_WEIGHT;
+  if (ahead < FRONT_WATCH_MM)
+  {
+    weight[0] += FRONT_WATCH_MM - (ahead > 0 ? ahead : 0);
+  }
+  
+  err = WALL_ERR_WATCH_MM;
+  if (pinger[1] != 0)
+  {
+    err = Clamp16((int32_t)pinger[1] - STEER_SETPOINT, WALL_ERR_WATCH_MM);
+    if (err < 0)
+    {
+      err = -err;
+    }
+  }
+  weight[1] = PING_BASE_WEIGHT + err * WALL_ERR_WEIGHT;
+  
+  weight[2] = PING_BASE_WEIGHT + (weight[0] - PING_BASE_WEIGHT) / 2;
+  
+  total = weight[0] + weight[1] + weight[2];
+  spare = PING_SLOTS;
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    pingSlots[n] = PING_MIN_SLOTS +
+      (uint8_t)((uint32_t)(PING_SLOTS - NUM_PINGERS * PING_MIN_SLOTS)
+                * weight[n] / total);
+    spare -= pingSlots[n];
+  }
+  
+  //the shares round down; the slots left over go to the front while it
+  //closes on something, else to the wall being followed
+  pingSlots[(pinger[0] == 0 || pingerRate[0] < 0) ? 0 : 1] += spare;
+  
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    pingPeriod[n] = PING_WINDOW_TICKS / pingSlots[n];
+  }
+}
+
+void PingTask(void)
+//------------------------------------------------------------------------
+// Func:  Fire the settled pinger furthest past its period. Triggers are
+//        kept PING_STAGGER_TICKS apart so all three can be in flight at
+//        once without firing together, which caps the total rate at
+//        PING_SLOTS per window; PingRates decides who gets them.
+//------------------------------------------------------------------------
+{
+  uint8_t n;
+  uint8_t sel;
+  uint8_t best = NUM_PINGERS;
+  int16_t late;
+  int16_t bestLate = 0;
+  
+  if ((uint16_t)(tickCount - lastTriggerTick) < PING_STAGGER_TICKS)
+  {
+    return;
+  }
+  PingRates();
+  
+  //ties go to the next pinger in the rotation
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    sel = (pinger_sel + n) % NUM_PINGERS;
+    late = (int16_t)(tickCount - lastPingTick[sel]) - pingPeriod[sel];
+    if (!(waiting & (1 << sel)) &&
+        (int16_t)(tickCount - nextPingTick[sel]) >= 0 &&
+        late >= 0 && (best == NUM_PINGERS || late > bestLate))
+    {
+      best = sel;
+      bestLate = late;
+    }
+  }
+  
+  if (best != NUM_PINGERS)
+  {
+    TriggerPinger(best);
+    lastTriggerTick = tickCount;
+    lastPingTick[best] = tickCount;
+    pinger_sel = (best + 1) % NUM_PINGERS;
+  }
+}
+
+void CaptureInit(void)
+//------------------------------------------------------------------------
+// Func:  Forget every echo and capture, the pingers start idle
+//        (RangingInit first, PingRates reads pinger[])
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  pulse_count[0] = 0;                           // Init input pulse counter
+  cycles[0] = 0;
+  cycles[1] = 0;
+  cycles[2] = 0;
+  fallingEdge[0] = 0;
+  risingEdge[0] = 0;
+  edge[0] = 0;
+  waiting = 0;
+  echoReady = 0;
+  captureHead = 0;
+  captureTail = 0;
+  lastPingTick[0] = 0;
+  lastPingTick[1] = 0;
+  lastPingTick[2] = 0;
+  echoTick[0] = tickCount - ECHO_STALE_TICKS - 1;  // No echo yet
+  echoTick[1] = echoTick[0];
+  echoTick[2] = echoTick[0];
+  pinger_sel = 0;
+  PingRates();
+}
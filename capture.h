@@ -0,0 +1,27 @@
+//------------------------------------------------------------------------
+// capture.h - Pinger triggers and echo captures. The capture ISRs
+//             queue timestamped edges through CapturePush (hal.h), the
+//             main loop pairs them into echo widths, and PingTask picks
+//             the next pinger to fire.
+//------------------------------------------------------------------------
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "robot.h"
+
+extern volatile uint32_t cycles[3];   // Last echo width per pinger (SMCLK cycles)
+extern volatile uint8_t waiting;      // Bit per pinger awaiting its echo
+extern volatile uint8_t echoReady;    // Bit per pinger with an unprocessed echo
+extern volatile uint16_t crosstalkCount[3]; // Echoes rejected as crosstalk
+
+void CaptureInit(void);
+uint8_t CaptureTick(void);            // From SchedulerTick, 1 = wake the main loop
+void ProcessCaptures(void);           // Pair the queued edges into echoes
+void TriggerPinger(uint8_t ping_num);
+uint8_t EchoSettled(uint8_t ping_num); // Any crosstalk partner is in too
+uint8_t EchoFresh(uint8_t ping_num);  // 1 = pinger[] backed by a recent echo
+uint8_t TakeEcho(uint8_t ping_num);   // 1 = claimed an unprocessed echo
+uint8_t IsCrosstalk(uint8_t ping_num);
+void PingTask(void);
+
+#endif
@@ -0,0 +1,49 @@
+//------------------------------------------------------------------------
+// clock.h - Build-time clock selection. Pick CLOCK_MHZ (1, 8 or 16, one
+//           of the F2274's calibrated DCO settings) here or with -D and
+//           everything timed in SMCLK cycles follows from it. MCLK and
+//           SMCLK both run straight off the DCO. 16 MHz needs VCC of at
+//           least 3.3 V, 8 MHz at least 2.2 V.
+//------------------------------------------------------------------------
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#ifndef CLOCK_MHZ
+#define CLOCK_MHZ 8
+#endif
+
+#if CLOCK_MHZ == 1
+#define ECHO_US_SHIFT 0               // SMCLK cycles -> us
+#define DEBUG_BAUD 9600               // Software UART out on P4.4 (TB1)
+#elif CLOCK_MHZ == 8
+#define ECHO_US_SHIFT 3
+#define DEBUG_BAUD 38400
+#elif CLOCK_MHZ == 16
+#define ECHO_US_SHIFT 4
+#define DEBUG_BAUD 57600
+#else
+#error "CLOCK_MHZ must be 1, 8 or 16"
+#endif
+
+#define SMCLK_HZ (CLOCK_MHZ * 1000000L)
+#define TICK_CYCLES (SMCLK_HZ / 1000) // SMCLK cycles per tick (1 ms)
+#define US_CYCLES(us) ((us) * CLOCK_MHZ) // SMCLK cycles in a time in us
+#define TRIGGER_CYCLES US_CYCLES(10)  // Shortest trigger pulse the pingers take
+#define DEBUG_BIT_CYCLES (SMCLK_HZ / DEBUG_BAUD)
+
+// USCI_A0 at MOTOR_BAUD, low-frequency mode. UCBRx and UCBRSx are taken
+// from the F2xx user's guide baud rate table (SLAU144, UCOS16 = 0), which
+// picks UCBRSx for the least bit error rather than by rounding
+#define MOTOR_BAUD 38400              // Sabertooth packet serial on USCI_A0
+#if CLOCK_MHZ == 1
+#define MOTOR_UCBR 26
+#define MOTOR_UCBRS 0
+#elif CLOCK_MHZ == 8
+#define MOTOR_UCBR 208
+#define MOTOR_UCBRS 2
+#else
+#define MOTOR_UCBR 416
+#define MOTOR_UCBRS 6
+#endif
+
+#endif
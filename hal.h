@@ -0,0 +1,54 @@
+//------------------------------------------------------------------------
+// hal.h - Thin hardware layer between the robot logic (main.c and its
+//         modules) and the board it runs on. hal_msp430.c drives the
+//         MSP430F2274 and host/hal_host.c runs the same logic on a PC
+//         against a simulated clock.
+//------------------------------------------------------------------------
+#ifndef HAL_H
+#define HAL_H
+
+#include "stdint.h"
+#include "clock.h"                    // SMCLK_HZ, TICK_CYCLES, bauds
+
+#define LED_RED   0x01                // P1.0
+#define LED_GREEN 0x02                // P1.1
+#define BUTTON    0x04                // P1.2, pressed = low
+
+#define ADC_TEMP 0                    // On-chip temperature sensor
+#define ADC_BATTERY 1                 // Motor pack via 100k/10k divider, A7 (P3.7)
+#define TEMP_ADC_OFFSET 673           // ADC10 temperature reading at 0 C
+#define TEMP_ADC_SCALE_Q10 423        // C per reading step above that (Q10)
+#define BATTERY_ADC_MV_Q4 258         // Pack mV per reading step (Q4), 1.5 V ref
+
+#define CAPTURE_RISING  0x01          // Input was high after the capture
+#define CAPTURE_OVERRUN 0x02          // COV: an earlier capture was lost
+
+// BOARD SIDE, ONE IMPLEMENTATION PER TARGET //
+void HalInit(void);                   // Clocks, ports, timers, UART, IRQs off
+void HalTriggerPulse(uint8_t ping_num); // TRIGGER_CYCLES pulse, timer ends it
+void HalLedOn(uint8_t leds);
+void HalLedOff(uint8_t leds);
+uint16_t HalCaptureTimer(uint8_t ping_num); // Free-running timer of a pinger
+void HalUartTxStart(void);            // Let the TX IRQ drain UartTxNext
+void HalDebugTxStart(void);           // Let the debug TX IRQ drain DebugTxNext
+uint16_t HalCycleTimer(void);         // Free-running count, 1 per MCLK cycle
+void HalAdcStart(uint8_t channel);    // One ADC10 conversion, ADC_xxx
+void HalDisableIrq(void);
+void HalEnableIrq(void);
+void HalSleep(void);                  // Enable IRQs and sleep until woken
+
+// LOGIC SIDE, CALLED BY THE BOARD FROM INTERRUPT CONTEXT //
+uint8_t SchedulerTick(void);          // Every tick, 1 = wake the main loop
+void CapturePush(uint8_t ping_num, uint8_t flags, uint32_t time);
+uint8_t UartTxNext(uint8_t *data);    // 1 = send *data, 0 = queue empty
+uint8_t DebugTxNext(uint8_t *data);   // Same for the debug channel
+void ButtonPressed(void);
+void AdcPush(uint8_t channel, uint16_t raw); // HalAdcStart's conversion is done
+uint32_t ExtendCapture(uint16_t high, uint16_t ccr_val, uint8_t ovf_pending);
+                                      // 32-bit time of a capture (capture.c)
+
+// LOGIC ENTRY POINTS //
+void RobotInit(void);
+void RobotStep(void);                 // Run released tasks, then sleep
+
+#endif
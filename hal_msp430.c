@@ -0,0 +1,435 @@
+//------------------------------------------------------------------------
+// hal_msp430.c - MSP430F2274 implementation of hal.h. All register
+//                access and interrupt vectors live here.
+//------------------------------------------------------------------------
+#include "msp430x22x4.h"
+#include "hal.h"
+#include "profile.h"
+
+//IAR names an ISR's vector with a pragma, msp430-gcc with an attribute.
+//in430.h maps the IAR intrinsics used below for msp430-gcc.
+#ifdef __ICC430__
+#define HAL_PRAGMA(text) _Pragma(#text)
+#define HAL_ISR(vec, name) HAL_PRAGMA(vector=vec) __interrupt void name (void)
+#else
+#define HAL_ISR(vec, name) void __attribute__((interrupt(vec))) name (void)
+#ifndef __even_in_range
+#define __even_in_range(value, bound) (value)
+#endif
+#endif
+
+//the trigger's end compare is set this far ahead at least, so it is
+//still ahead of TBR once written even at 1 MHz; a longer pulse is fine
+#define TRIGGER_LEAD_CYCLES 32
+#if TRIGGER_CYCLES > TRIGGER_LEAD_CYCLES
+#define TRIGGER_END_CYCLES TRIGGER_CYCLES
+#else
+#define TRIGGER_END_CYCLES TRIGGER_LEAD_CYCLES
+#endif
+
+volatile uint16_t timerAHigh;         //Timer_A overflows, upper half of time
+volatile uint16_t timerBHigh;         //Timer_B overflows, upper half of time
+uint16_t debugFrame;                  //Bits of the debug byte still to send
+uint8_t debugBits;                    //Count of them, 0 = between bytes
+volatile uint16_t debugLateCount;     //Frames cut short by a missed compare
+volatile uint16_t triggerLateCount;   //Trigger pulses ended by hand
+uint8_t adcChannel;                   //ADC_xxx being converted
+uint8_t triggerPins;                  //P2 trigger pins TBCCR2 will lower
+
+uint8_t CaptureFlags( uint16_t cctl )
+{
+  uint8_t flags = 0;
+  if (cctl & CCI)
+  {
+    flags |= CAPTURE_RISING;
+  }
+  if (cctl & COV)
+  {
+    flags |= CAPTURE_OVERRUN;
+  }
+  return flags;
+}
+
+//the capture ISRs only timestamp the edge, clear COV and queue it
+HAL_ISR(TIMERA0_VECTOR, Isrtimera0)
+{
+  uint16_t cctl = TACCTL0;
+  PROFILE_START(PROFILE_ISR_TA0);
+  CapturePush(0, CaptureFlags(cctl),
+              ExtendCapture(timerAHigh, TACCR0, TACTL & TAIFG));
+  TACCTL0 &= ~COV;
+  _BIC_SR_IRQ(LPM1_bits);               // wake the main loop
+  PROFILE_STOP(PROFILE_ISR_TA0);
+}
+
+HAL_ISR(TIMERB0_VECTOR, Isrtimerb0)
+{
+  uint16_t cctl = TBCCTL0;
+  PROFILE_START(PROFILE_ISR_TB0);
+  CapturePush(2, CaptureFlags(cctl),
+              ExtendCapture(timerBHigh, TBCCR0, TBCTL & TBIFG));
+  TBCCTL0 &= ~COV;
+  _BIC_SR_IRQ(LPM1_bits);               // wake the main loop
+  PROFILE_STOP(PROFILE_ISR_TB0);
+}
+
+HAL_ISR(TIMERA1_VECTOR, IsrCntPulseTACC1)
+//--------------------------------------------------------------------------
+// Func:  At TACCR1 IRQ queue the capture, at TACCR2 run the scheduler
+//        tick and at TAR rollover count the overflow
+// Args:  None
+// Retn:  None
+//--------------------------------------------------------------------------
+{
+  PROFILE_START(PROFILE_ISR_TA1);
+  switch (__even_in_range(TAIV, 10))  // I.D. source of TA IRQ
+  {
+    case TAIV_TACCR1:                 // handle chnl 1 IRQ
+        CapturePush(1, CaptureFlags(TACCTL1),
+                    ExtendCapture(timerAHigh, TACCR1, TACTL & TAIFG));
+        TACCTL1 &= ~COV;
+        _BIC_SR_IRQ(LPM1_bits);         // wake the main loop
+      break;
+    case TAIV_TACCR2:                 // scheduler tick
+        TACCR2 += TICK_CYCLES;
+        if (SchedulerTick())
+        {
+          _BIC_SR_IRQ(LPM1_bits);       // wake the main loop
+        }
+      break;
+    case TAIV_TAIFG:                  // TAR rollover
+        timerAHigh++;
+      break;
+    default:                          // ignore everything else
+      break;
+  }
+  PROFILE_STOP(PROFILE_ISR_TA1);
+}
+
+void DebugTxBit (void)
+//------------------------------------------------------------------------
+// Func:  At a TBCCR1 compare, the level set up last time has just been
+//        driven onto P4.4 by the timer, so the edge has no IRQ latency
+//        jitter. Set up the next bit one bit time later, start the next
+//        queued byte once the stop bit is out, or go idle (high).
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint8_t data;
+
+  if (debugBits == 0)
+  {
+    if (!DebugTxNext(&data))
+    {
+      TBCCTL1 = OUTMOD_1;               // Idle high, IRQ off
+      return;
+    }
+    debugFrame = ((uint16_t)data << 1) | 0x200; // Start 0, 8 data, stop 1
+    debugBits = 10;
+  }
+
+  if (debugFrame & 0x01)
+  {
+    TBCCTL1 = OUTMOD_1 | CCIE;          // Set at the next compare
+  }
+  else
+  {
+    TBCCTL1 = OUTMOD_5 | CCIE;          // Reset at the next compare
+  }
+  debugFrame >>= 1;
+  debugBits--;
+  TBCCR1 += DEBUG_BIT_CYCLES;
+
+  //serviced more than a bit late: the compare is already behind TBR and
+  //would only fire after a full timer wrap, with the line stuck at this
+  //bit. Drop the rest of the byte and idle a whole frame so the
+  //receiver finds the next start bit.
+  if ((int16_t)(TBCCR1 - TBR) <= 0)
+  {
+    debugLateCount++;
+    TBCCTL1 = OUT;                      // Idle high now
+    debugBits = 0;
+    TBCCR1 = TBR + 10 * DEBUG_BIT_CYCLES;
+    TBCCTL1 = OUTMOD_1 | CCIE;          // Still high, next byte after that
+  }
+}
+
+HAL_ISR(TIMERB1_VECTOR, IsrTimerB1)
+//--------------------------------------------------------------------------
+// Func:  At TBCCR1 clock out the debug UART, at TBCCR2 end the trigger
+//        pulse, at TBR rollover count the overflow for 32-bit capture times
+// Args:  None
+// Retn:  None
+//--------------------------------------------------------------------------
+{
+  PROFILE_START(PROFILE_ISR_TB1);
+  switch (__even_in_range(TBIV, 14))  // I.D. source of TB IRQ
+  {
+    case TBIV_TBCCR1:                 // debug UART bit boundary
+        DebugTxBit();
+      break;
+    case TBIV_TBCCR2:                 // trigger pulse is long enough
+        P2OUT &= ~triggerPins;        // Set Pin(s) Low
+        triggerPins = 0;
+        TBCCTL2 = 0;                  // One-shot, IRQ off
+      break;
+    case TBIV_TBIFG:                  // TBR rollover
+        timerBHigh++;
+      break;
+    default:                          // ignore everything else
+      break;
+  }
+  PROFILE_STOP(PROFILE_ISR_TB1);
+}
+
+HAL_ISR(USCIAB0TX_VECTOR, IsrUartTx)
+//------------------------------------------------------------------------
+// Func:  At UCA0TXIFG IRQ, send the next queued byte or stop when empty
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint8_t data;
+  PROFILE_START(PROFILE_ISR_UART);
+
+  if (UartTxNext(&data))
+  {
+    UCA0TXBUF = data;
+  }
+  else
+  {
+    IE2 &= ~UCA0TXIE;                   // Nothing left, mask the IRQ
+  }
+  PROFILE_STOP(PROFILE_ISR_UART);
+}
+
+HAL_ISR(ADC10_VECTOR, IsrAdc10)
+//------------------------------------------------------------------------
+// Func:  At the end of a conversion, hand over the reading
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  PROFILE_START(PROFILE_ISR_ADC);
+  AdcPush(adcChannel, ADC10MEM);        // ADC10IFG clears on entry
+  PROFILE_STOP(PROFILE_ISR_ADC);
+}
+
+HAL_ISR(PORT1_VECTOR, IsrPort1)
+//------------------------------------------------------------------------
+// Func:  At the P1.2 button's falling edge, tell the logic
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  PROFILE_START(PROFILE_ISR_PORT1);
+  if (P1IFG & BUTTON)
+  {
+    P1IFG &= ~BUTTON;
+    ButtonPressed();
+  }
+  PROFILE_STOP(PROFILE_ISR_PORT1);
+}
+
+void InitPorts (void)
+//------------------------------------------------------------------------
+// Func:  Initialize the ports for I/O on TA1 Capture
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  P1DIR |= 0x03;                      // Config P1.0 as Output (LED)
+  P1REN |= BUTTON;                    // P1.2 button pulled up,
+  P1OUT |= BUTTON;                    // IRQ on the press (falling edge)
+  P1IES |= BUTTON;
+  P1IFG &= ~BUTTON;
+  P1IE  |= BUTTON;
+  P2DIR &= ~0x0C;                     // P2.3 % 2.2 = Input
+  P2SEL |= 0x0C;                      // P2.3 & 2.2 = TA1 & TA0 = TA compare OUT1
+  P2DIR |= 0x13;
+  P2OUT |= 0x13;                      // Toggle P2.0 = toggle LED
+  P4DIR &= ~0x08;                     // P4.3 = Input
+  P4SEL |= 0x08;                      // P4.3 = TB0 = TB compare OUT1
+  P4DIR |= 0x10;                      // P4.4 = TB1 out = debug UART TX
+  P4SEL |= 0x10;
+  P3SEL = 0x30;                       // P3.4,5 = USCI_A0 TXD/RXD
+}
+
+void HalInit (void)
+//------------------------------------------------------------------------
+// Func:  Stop the watchdog, set up ports, clocks, timers and the UART.
+//        IRQs stay disabled until HalEnableIrq.
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  WDTCTL = WDTPW | WDTHOLD;                  //Stop Watchdog Timer
+
+#if CLOCK_MHZ == 16
+  BCSCTL1 = CALBC1_16MHZ;                    // DCO = 16 MHz
+  DCOCTL  = CALDCO_16MHZ;
+#elif CLOCK_MHZ == 8
+  BCSCTL1 = CALBC1_8MHZ;                     // DCO = 8 MHz
+  DCOCTL  = CALDCO_8MHZ;
+#else
+  BCSCTL1 = CALBC1_1MHZ;                     // DCO = 1 MHz
+  DCOCTL  = CALDCO_1MHZ;
+#endif
+
+  InitPorts();                               //  Configure I/O Pins
+
+  TACTL   = TASSEL_2 | ID_0 | MC_2;          // SMCLK | Div by 1 | Contin Mode
+  TACCTL0 = CM0 | CM1 | CCIS0 | CAP | SCS | CCIE;  // Ris Edge | Falling Edge | inp = CCI1B |
+                                             // Capture | Sync Cap | Enab IRQ
+  TACCTL1 = CM0 | CM1 | CCIS0 | CAP | SCS | CCIE;  // Ris Edge | Falling Edge | inp = CCI1B |
+                                             // Capture | Sync Cap | Enab IRQ
+  TACCR2  = TICK_CYCLES;                     // First scheduler tick
+  TACCTL2 = CCIE;                            // Compare | Enab IRQ
+  TBCTL   = TASSEL_2 | ID_0 | MC_2;          // SMCLK | Div by 1 | Contin Mode
+  TACTL  |= TACLR;                           // Restart both timers together so
+  TBCTL  |= TBCLR;                           // TAR and TBR share one time base
+  timerAHigh = 0;
+  timerBHigh = 0;
+  TACTL  |= TAIE;                            // Count overflows for 32-bit
+  TBCTL  |= TBIE;                            // capture timestamps
+  TBCCTL0 = CM0 | CM1 | CCIS0 | CAP | SCS | CCIE;  // Ris Edge | Falling Edge | inp = CCI1B |
+                                             // Capture | Sync Cap | Enab IRQ
+  TBCCTL1 = OUT;                             // Debug UART idles high
+  debugBits = 0;
+  TBCCTL2 = 0;                               // Trigger one-shot, armed per ping
+  triggerPins = 0;
+
+  // Config. UART Clock & Baud Rate
+  UCA0CTL1 |= UCSSEL_2;                 // UART use SMCLK
+
+  UCA0MCTL = MOTOR_UCBRS * UCBRS0;      // Map SMCLK -> MOTOR_BAUD (clock.h)
+  UCA0BR0  = MOTOR_UCBR & 0xFF;
+  UCA0BR1  = MOTOR_UCBR >> 8;
+
+  UCA0CTL1 &= ~UCSWRST;                 // Enable USCI state mach
+
+  // Temperature sensor and battery divider on the 1.5 V reference, left
+  // powered so a conversion needs no reference settling wait
+  ADC10AE0 |= 0x80;                     // P3.7 = A7 = battery divider
+  ADC10CTL1 = INCH_10 | ADC10DIV_3;     // Temp sensor | ADC10OSC / 4
+  ADC10CTL0 = SREF_1 | ADC10SHT_3 | REFON | ADC10ON | ADC10IE;
+                                        // 64 clk sample > 30 us for the sensor
+}
+
+void HalTriggerPulse( uint8_t ping_num )
+{
+  __istate_t state = __get_interrupt_state();
+
+  __disable_interrupt();
+  //left
+  if (ping_num == 1)
+  {
+    triggerPins |= 0x01;                    // P2.0
+  }
+  //front
+  if (ping_num == 0)
+  {
+    triggerPins |= 0x10;                    // P2.4
+  }
+  //right
+  if (ping_num == 2)
+  {
+    triggerPins |= 0x02;                    // P2.1
+  }
+  P2OUT |= triggerPins;                     // Set Pin(s) High
+
+  //TBCCR2 ends the pulse. A compare that TBR has already passed would
+  //only fire after a full timer wrap, with the pin held high for it;
+  //by then the pulse is long enough, so end it here. A match after the
+  //check still sets CCIFG, and |= keeps it pending for the IRQ.
+  TBCCTL2 = 0;
+  TBCCR2 = TBR + TRIGGER_END_CYCLES;
+  if ((int16_t)(TBCCR2 - TBR) <= 0)
+  {
+    triggerLateCount++;
+    P2OUT &= ~triggerPins;
+    triggerPins = 0;
+    TBCCTL2 = 0;
+  }
+  else
+  {
+    TBCCTL2 |= CCIE;
+  }
+  __set_interrupt_state(state);
+}
+
+void HalLedOn( uint8_t leds )
+{
+  P1OUT |= leds;
+}
+
+void HalLedOff( uint8_t leds )
+{
+  P1OUT &= ~leds;
+}
+
+uint16_t HalCaptureTimer( uint8_t ping_num )
+{
+  if (ping_num == 2)
+  {
+    return TBR;
+  }
+  return TAR;
+}
+
+void HalUartTxStart (void)
+{
+  IE2 |= UCA0TXIE;                      // TX IRQ drains the queue
+}
+
+void HalDebugTxStart (void)
+{
+  __istate_t state = __get_interrupt_state();
+
+  __disable_interrupt();
+  if (!(TBCCTL1 & CCIE))
+  {
+    //idle one bit first, then DebugTxBit takes the first byte
+    debugBits = 0;
+    TBCCR1 = TBR + DEBUG_BIT_CYCLES;
+    TBCCTL1 = OUTMOD_1 | CCIE;
+  }
+  __set_interrupt_state(state);
+}
+
+void HalAdcStart (uint8_t channel)
+{
+  ADC10CTL0 &= ~ENC;                    // INCH only changes with ENC low
+  if (channel == ADC_BATTERY)
+  {
+    ADC10CTL1 = INCH_7 | ADC10DIV_3;
+  }
+  else
+  {
+    ADC10CTL1 = INCH_10 | ADC10DIV_3;
+  }
+  adcChannel = channel;
+  ADC10CTL0 |= ENC | ADC10SC;           // IsrAdc10 fires when done
+}
+
+uint16_t HalCycleTimer (void)
+{
+  return TAR;                           // SMCLK = MCLK = DCO
+}
+
+void HalDisableIrq (void)
+{
+  _DINT();
+}
+
+void HalEnableIrq (void)
+{
+  _EINT();
+}
+
+void HalSleep (void)
+{
+  _BIS_SR(LPM1_bits + GIE);             // GIE and LPM set together so an
+                                        // IRQ can't slip in before we sleep
+}
@@ -0,0 +1,367 @@
+//------------------------------------------------------------------------
+// hal_host.c - Host implementation of hal.h. Nothing runs concurrently:
+//              HalSleep advances simulated time to the next event and
+//              calls the logic's IRQ hooks the way the MSP430 ISRs do,
+//              until one of them asks to wake the main loop.
+//------------------------------------------------------------------------
+#include <math.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include "hal.h"
+#include "hal_host.h"
+
+#define HOST_MAX_EDGES 16
+
+typedef struct
+{
+  uint64_t time;
+  uint8_t ping_num;
+  uint8_t flags;
+} HostEdge;
+
+//one TX-only serial port, fed by the logic's xxxTxNext hook
+typedef struct
+{
+  uint8_t (*next)(uint8_t *data);
+  HostUartFn sink;
+  uint32_t byteCycles;
+  uint8_t enabled;                    // TX IRQ enabled
+  uint8_t busy;
+  uint8_t data;
+  uint64_t done;
+} HostSerial;
+
+static uint64_t hostNow;
+static uint64_t hostEnd;
+static uint64_t nextTick;
+
+static HostEdge edges[HOST_MAX_EDGES]; // Pending captures, sorted by time
+static uint8_t edgeCount;
+static uint8_t pulseActive;           // Bit per pinger with edges pending
+static uint8_t triggerHigh;           // Bit per pinger with its trigger up
+static uint64_t triggerEnd;           // When the TBCCR2 one-shot lowers them
+
+static HostSerial uart = { UartTxNext, NULL,
+                           (uint32_t)SMCLK_HZ * 10 / MOTOR_BAUD };
+static HostSerial debug = { DebugTxNext, NULL,
+                            (uint32_t)SMCLK_HZ * 10 / DEBUG_BAUD };
+
+static uint8_t leds;
+
+//ADC10 readings per ADC_xxx, 20 C and 12 V until set
+static uint16_t adcReading[2] =
+{
+  TEMP_ADC_OFFSET + (20 * 1024 + TEMP_ADC_SCALE_Q10 / 2) / TEMP_ADC_SCALE_Q10,
+  (12000 * 16 + BATTERY_ADC_MV_Q4 / 2) / BATTERY_ADC_MV_Q4
+};
+static uint8_t adcBusy;
+static uint8_t adcChannel;
+static uint64_t adcDone;
+
+static HostEchoFn echoModel;
+static HostStepFn stepHook;
+static jmp_buf hostExit;
+
+void HostSetEchoModel( HostEchoFn echo )
+{
+  echoModel = echo;
+}
+
+void HostSetUartSink( HostUartFn sink )
+{
+  uart.sink = sink;
+}
+
+void HostSetDebugSink( HostUartFn sink )
+{
+  debug.sink = sink;
+}
+
+void HostSetStepHook( HostStepFn step )
+{
+  stepHook = step;
+}
+
+void HostSetBaud( uint32_t baud )
+{
+  uart.byteCycles = (uint32_t)SMCLK_HZ * 10 / baud;
+}
+
+void HostSetAirTemp( double celsius )
+{
+  adcReading[ADC_TEMP] = (uint16_t)lround(TEMP_ADC_OFFSET +
+                                          celsius * 1024.0 / TEMP_ADC_SCALE_Q10);
+}
+
+void HostSetBattery( double mv )
+{
+  long raw = lround(mv * 16.0 / BATTERY_ADC_MV_Q4);
+
+  adcReading[ADC_BATTERY] = (uint16_t)(raw < 0 ? 0 : raw > 1023 ? 1023 : raw);
+}
+
+uint64_t HostNow( void )
+{
+  return hostNow;
+}
+
+uint8_t HostLeds( void )
+{
+  return leds;
+}
+
+static void AddEdge( uint64_t time, uint8_t ping_num, uint8_t flags )
+{
+  uint8_t n = edgeCount;
+
+  if (edgeCount == HOST_MAX_EDGES)
+  {
+    return;
+  }
+  while (n > 0 && edges[n - 1].time > time)
+  {
+    edges[n] = edges[n - 1];
+    n--;
+  }
+  edges[n].time = time;
+  edges[n].ping_num = ping_num;
+  edges[n].flags = flags;
+  edgeCount++;
+}
+
+static HostEdge PopEdge( void )
+{
+  HostEdge first = edges[0];
+  uint8_t n;
+
+  for (n = 1; n < edgeCount; n++)
+  {
+    edges[n - 1] = edges[n];
+  }
+  edgeCount--;
+  return first;
+}
+
+static void SerialService( HostSerial *port )
+{
+  if (port->busy || !port->enabled)
+  {
+    return;
+  }
+  if (port->next(&port->data))
+  {
+    port->busy = 1;
+    port->done = hostNow + port->byteCycles;
+  }
+  else
+  {
+    port->enabled = 0;                // Queue empty, IRQ masks itself
+  }
+}
+
+//finish the port's byte if it is due at now
+static uint8_t SerialDone( HostSerial *port )
+{
+  if (!port->busy || port->done != hostNow)
+  {
+    return 0;
+  }
+  port->busy = 0;
+  if (port->sink != NULL)
+  {
+    port->sink(port->data, hostNow);
+  }
+  SerialService(port);
+  return 1;
+}
+
+void HalInit( void )
+{
+  hostNow = 0;
+  nextTick = TICK_CYCLES;
+  edgeCount = 0;
+  pulseActive = 0;
+  triggerHigh = 0;
+  uart.enabled = 0;
+  uart.busy = 0;
+  debug.enabled = 0;
+  debug.busy = 0;
+  adcBusy = 0;
+  leds = 0;
+}
+
+void HalTriggerPulse( uint8_t ping_num )
+{
+  triggerHigh |= 1 << ping_num;
+  triggerEnd = hostNow + TRIGGER_CYCLES;
+}
+
+//the one-shot ended the trigger pulses, the pingers start their bursts
+static void TriggersEnd( void )
+{
+  uint8_t n;
+  uint32_t width;
+  uint64_t rise;
+
+  for (n = 0; n < 3; n++)
+  {
+    if (!(triggerHigh & (1 << n)))
+    {
+      continue;
+    }
+    triggerHigh &= ~(1 << n);
+
+    //like the real sensors, a pinger still sending an echo ignores triggers
+    if (echoModel == NULL || (pulseActive & (1 << n)))
+    {
+      continue;
+    }
+    width = echoModel(n, hostNow);
+    if (width != 0)
+    {
+      rise = hostNow + HOST_ECHO_DELAY_CYCLES;
+      AddEdge(rise, n, CAPTURE_RISING);
+      AddEdge(rise + width, n, 0);
+      pulseActive |= 1 << n;
+    }
+  }
+}
+
+void HalLedOn( uint8_t on )
+{
+  leds |= on;
+}
+
+void HalLedOff( uint8_t off )
+{
+  leds &= ~off;
+}
+
+uint16_t HalCaptureTimer( uint8_t ping_num )
+{
+  (void)ping_num;
+  return (uint16_t)hostNow;
+}
+
+void HalUartTxStart( void )
+{
+  uart.enabled = 1;
+  SerialService(&uart);
+}
+
+void HalDebugTxStart( void )
+{
+  debug.enabled = 1;
+  SerialService(&debug);
+}
+
+void HalAdcStart( uint8_t channel )
+{
+  if (!adcBusy)
+  {
+    adcBusy = 1;
+    adcChannel = channel;
+    adcDone = hostNow + HOST_ADC_CYCLES;
+  }
+}
+
+uint16_t HalCycleTimer( void )
+{
+  return (uint16_t)hostNow;           // Code takes no simulated time
+}
+
+void HalDisableIrq( void )
+{
+}
+
+void HalEnableIrq( void )
+{
+}
+
+void HalSleep( void )
+//------------------------------------------------------------------------
+// Func:  Dispatch simulated IRQs in time order until one wakes the
+//        main loop, or leave HostRunFirmware once the run is over
+//------------------------------------------------------------------------
+{
+  uint8_t wake = 0;
+  uint64_t t;
+  HostEdge e;
+
+  while (!wake)
+  {
+    t = nextTick;
+    if (edgeCount != 0 && edges[0].time < t)
+    {
+      t = edges[0].time;
+    }
+    if (uart.busy && uart.done < t)
+    {
+      t = uart.done;
+    }
+    if (debug.busy && debug.done < t)
+    {
+      t = debug.done;
+    }
+    if (adcBusy && adcDone < t)
+    {
+      t = adcDone;
+    }
+    if (triggerHigh != 0 && triggerEnd < t)
+    {
+      t = triggerEnd;
+    }
+    if (t > hostEnd)
+    {
+      longjmp(hostExit, 1);
+    }
+
+    if (stepHook != NULL)
+    {
+      stepHook(t);
+    }
+    hostNow = t;
+
+    if (SerialDone(&uart) || SerialDone(&debug))
+    {
+      //bytes leaving a UART don't wake the main loop
+    }
+    else if (adcBusy && adcDone == t)
+    {
+      adcBusy = 0;
+      AdcPush(adcChannel, adcReading[adcChannel]);
+    }
+    else if (triggerHigh != 0 && triggerEnd == t)
+    {
+      TriggersEnd();
+    }
+    else if (edgeCount != 0 && edges[0].time == t)
+    {
+      e = PopEdge();
+      if (!(e.flags & CAPTURE_RISING))
+      {
+        pulseActive &= ~(1 << e.ping_num);
+      }
+      CapturePush(e.ping_num, e.flags, (uint32_t)e.time);
+      wake = 1;
+    }
+    else
+    {
+      nextTick += TICK_CYCLES;
+      wake = SchedulerTick();
+    }
+  }
+}
+
+void HostRunFirmware( uint64_t cycles )
+{
+  hostEnd = cycles;
+  if (setjmp(hostExit) == 0)
+  {
+    RobotInit();
+    while (1)
+    {
+      RobotStep();
+    }
+  }
+}
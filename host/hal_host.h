@@ -0,0 +1,37 @@
+//------------------------------------------------------------------------
+// hal_host.h - Host (Linux/gcc) side of hal.h. Runs the firmware against
+//              a simulated SMCLK so it can be driven at many times real
+//              time. The simulator supplies echo widths and receives the
+//              bytes sent to the Sabertooth and the debug channel.
+//------------------------------------------------------------------------
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include "stdint.h"
+
+#define HOST_ECHO_DELAY_CYCLES US_CYCLES(450) // Trigger end to echo rise
+#define HOST_ADC_CYCLES US_CYCLES(60) // ADC10 conversion time
+
+//echo width in SMCLK cycles for a pinger triggered at now, 0 = no echo
+typedef uint32_t (*HostEchoFn)(uint8_t ping_num, uint64_t now);
+//a byte finished leaving the UART at now
+typedef void (*HostUartFn)(uint8_t data, uint64_t now);
+//called before every simulated event, for models that integrate time
+typedef void (*HostStepFn)(uint64_t now);
+
+void HostSetEchoModel(HostEchoFn echo);
+void HostSetUartSink(HostUartFn sink);
+void HostSetDebugSink(HostUartFn sink); // Debug channel (hal.h DEBUG_BAUD)
+void HostSetStepHook(HostStepFn step);
+void HostSetBaud(uint32_t baud);
+void HostSetAirTemp(double celsius);  // What the ADC10 sensor reads, 20 C default
+void HostSetBattery(double mv);       // Motor pack voltage, 12 V default
+
+uint64_t HostNow(void);               // Simulated SMCLK cycles since start
+uint8_t HostLeds(void);               // LED_RED | LED_GREEN currently lit
+
+//run RobotInit and RobotStep until the given simulated time has passed.
+//Firmware globals are not reset, so run once per process.
+void HostRunFirmware(uint64_t cycles);
+
+#endif
@@ -0,0 +1,96 @@
+//------------------------------------------------------------------------
+// ranging_bench.c - Times CalculateDist, echo width to pinger[], on the
+//                   host. Built twice by host/Makefile: as is, and with
+//                   -DRANGE_FLOAT for the float path it replaced. The
+//                   numbers are host CPU time, which has an FPU; they
+//                   say nothing about the F2274's software float. For
+//                   the MSP430, time the same two builds with PROFILE.
+//
+//   ranging_bench [samples]
+//------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ranging.h"
+#include "capture.h"
+#include "motor.h"
+
+#define RUNS 5                        // Best of
+
+static uint32_t seed = 1;
+
+//echo widths in SMCLK cycles: a wall drifting between 300 and 3000 mm,
+//+-1% noise and one echo in 20 a multipath spike
+static uint32_t NextWidth( uint8_t ping_num, uint32_t n )
+{
+  uint32_t mm = 300 + (n / 3 + 900 * ping_num) % 2700;
+  uint32_t width;
+
+  seed = seed * 1103515245UL + 12345;
+  width = mm * 5818UL / 1000 * CLOCK_MHZ;      // us per mm there and back
+  width += (width / 50) * ((seed >> 16) & 0xFF) / 256;
+  if (((seed >> 8) & 0xFF) < 13)
+  {
+    width += width / 2;
+  }
+  return width;
+}
+
+static double Run( uint32_t samples, const uint32_t *widths )
+{
+  struct timespec start;
+  struct timespec end;
+  uint32_t n;
+
+  RangingInit();
+  MotorInit();
+  tickCount = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (n = 0; n < samples; n++)
+  {
+    tickCount += 4;                   // One trigger slot per sample
+    cycles[n % 3] = widths[n];
+    CalculateDist(n % 3);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return ((end.tv_sec - start.tv_sec) * 1e9 +
+          (end.tv_nsec - start.tv_nsec)) / samples;
+}
+
+int main( int argc, char **argv )
+{
+  uint32_t samples = argc > 1 ? strtoul(argv[1], NULL, 0) : 3000000;
+  uint32_t *widths = malloc(samples * sizeof *widths);
+  uint32_t n;
+  double best = 0;
+  double ns;
+  int r;
+
+  if (widths == NULL || samples == 0)
+  {
+    return 1;
+  }
+  for (n = 0; n < samples; n++)
+  {
+    widths[n] = NextWidth(n % 3, n);
+  }
+
+  for (r = 0; r < RUNS; r++)
+  {
+    ns = Run(samples, widths);
+    if (r == 0 || ns < best)
+    {
+      best = ns;
+    }
+  }
+
+#ifdef RANGE_FLOAT
+  printf("float vote, float mm:       ");
+#else
+  printf("Hampel, tracker, Q16 mm:    ");
+#endif
+  printf("%.1f ns per sample, best of %d x %lu (last range %u mm)\n",
+         best, RUNS, (unsigned long)samples, pinger[(samples - 1) % 3]);
+  free(widths);
+  return 0;
+}
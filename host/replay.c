@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------
+// replay.c - Feed a recorded echo log back through the firmware and
+//            print every byte it sends to the Sabertooth, so two
+//            firmware revisions can be diffed on the same run.
+//
+//   replay echoes.csv > trace.csv
+//
+// The log has one line per trigger, "cycles,pinger,width" (width in
+// SMCLK cycles, 0 = no echo); sim -e writes it, and a logic analyser
+// capture of the trigger and echo pins converts to it directly. Each
+// pinger's widths are handed out in trigger order, so the run does not
+// depend on the firmware triggering at exactly the logged times. How
+// far the triggers drifted from the log is reported on stderr.
+//------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "hal_host.h"
+
+typedef struct
+{
+  uint64_t *time;
+  uint32_t *width;
+  size_t count;
+  size_t size;
+  size_t next;
+} EchoQueue;
+
+static EchoQueue queue[3];
+static uint64_t lastTime;
+static uint64_t maxDrift;
+static uint32_t lateTriggers;         // Triggers after the log ran out
+
+static void Append( EchoQueue *q, uint64_t time, uint32_t width )
+{
+  if (q->count == q->size)
+  {
+    q->size = q->size ? q->size * 2 : 1024;
+    q->time = realloc(q->time, q->size * sizeof(*q->time));
+    q->width = realloc(q->width, q->size * sizeof(*q->width));
+    if (q->time == NULL || q->width == NULL)
+    {
+      perror("replay");
+      exit(1);
+    }
+  }
+  q->time[q->count] = time;
+  q->width[q->count] = width;
+  q->count++;
+}
+
+static uint32_t ReplayEcho( uint8_t ping_num, uint64_t now )
+{
+  EchoQueue *q = &queue[ping_num];
+  uint64_t drift;
+
+  if (q->next == q->count)
+  {
+    lateTriggers++;
+    return 0;
+  }
+  drift = now > q->time[q->next] ? now - q->time[q->next]
+                                  : q->time[q->next] - now;
+  if (drift > maxDrift)
+  {
+    maxDrift = drift;
+  }
+  return q->width[q->next++];
+}
+
+static void TraceByte( uint8_t data, uint64_t now )
+{
+  printf("%llu,%u\n", (unsigned long long)now, data);
+}
+
+int main( int argc, char **argv )
+{
+  FILE *in;
+  char line[128];
+  unsigned long long time;
+  unsigned ping;
+  unsigned long width;
+  int n;
+
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s echoes.csv > trace.csv\n", argv[0]);
+    return 2;
+  }
+  if ((in = fopen(argv[1], "r")) == NULL)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    //the header and anything else that isn't a record is skipped
+    if (sscanf(line, "%llu,%u,%lu", &time, &ping, &width) == 3 && ping < 3)
+    {
+      Append(&queue[ping], time, (uint32_t)width);
+      if (time > lastTime)
+      {
+        lastTime = time;
+      }
+    }
+  }
+  fclose(in);
+
+  printf("cycles,byte\n");
+  HostSetEchoModel(ReplayEcho);
+  HostSetUartSink(TraceByte);
+  HostRunFirmware(lastTime + TICK_CYCLES);
+
+  for (n = 0; n < 3; n++)
+  {
+    fprintf(stderr, "pinger %d: %zu of %zu echoes replayed\n",
+            n, queue[n].next, queue[n].count);
+  }
+  fprintf(stderr, "max trigger drift %llu cycles, %u triggers past the log\n",
+          (unsigned long long)maxDrift, lateTriggers);
+  return 0;
+}
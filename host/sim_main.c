@@ -0,0 +1,248 @@
+//------------------------------------------------------------------------
+// sim_main.c - Run the firmware on the host in the simulated hallway of
+//              world.c and report how the robot did. With -n each run
+//              is forked so it starts from fresh firmware state, and one
+//              CSV line is printed per seed.
+//
+//   sim [-t seconds] [-s seed] [-n runs] [-w width_mm] [-y start_mm]
+//       [-a start_deg] [-N noise_mm] [-D dropout] [-M multipath]
+//       [-T air_C] [-V battery_mV] [-S drain_mV_s] [-o x,y,size ...]
+//       [-d capture] [-e echoes.csv]
+//
+//   -d writes the firmware's debug channel (telemetry frames and profile
+//   dumps) to a file for telemetry_decode.
+//   -e logs every trigger and the echo width it got, for replay.
+//------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "hal.h"
+#include "hal_host.h"
+#include "world.h"
+
+#define MAX_BOXES 8
+
+extern volatile uint16_t pinger[3];
+extern volatile uint16_t pulse_count[3];
+extern volatile uint16_t echoTimeoutCount[3];
+extern volatile uint16_t crosstalkCount[3];
+extern volatile uint16_t covCount[3];
+extern volatile uint16_t hampelCount[3];
+extern volatile uint8_t txDepthMax;
+extern volatile uint16_t txOverflowCount;
+extern volatile uint16_t motorSuppressedCount;
+extern volatile uint16_t telemetrySkipCount;
+extern volatile uint16_t debugOverflowCount;
+
+static double box[MAX_BOXES][3];
+static int boxCount;
+static uint32_t motorBytes;
+static FILE *debugOut;
+static FILE *echoOut;
+
+static void CountMotorBytes( uint8_t data, uint64_t now )
+{
+  motorBytes++;
+  WorldUartByte(data, now);
+}
+
+static void SaveDebugByte( uint8_t data, uint64_t now )
+{
+  (void)now;
+  fputc(data, debugOut);
+}
+
+static uint32_t LogEcho( uint8_t ping_num, uint64_t now )
+{
+  uint32_t width = WorldEcho(ping_num, now);
+
+  fprintf(echoOut, "%llu,%u,%u\n", (unsigned long long)now, ping_num, width);
+  return width;
+}
+
+//the world's battery drains as it runs, keep the ADC reading on it
+static void SimStep( uint64_t now )
+{
+  WorldStep(now);
+  HostSetBattery(WorldBatteryMv());
+}
+
+static void RunOnce( const WorldConfig *config, double seconds )
+{
+  int n;
+
+  WorldInit(config);
+  for (n = 0; n < boxCount; n++)
+  {
+    WorldAddBox(box[n][0], box[n][1], box[n][2]);
+  }
+  HostSetEchoModel(echoOut != NULL ? LogEcho : WorldEcho);
+  HostSetUartSink(CountMotorBytes);
+  HostSetDebugSink(debugOut != NULL ? SaveDebugByte : NULL);
+  HostSetStepHook(SimStep);
+  HostSetAirTemp(config->airTemp);
+  HostRunFirmware((uint64_t)(seconds * SMCLK_HZ));
+}
+
+static void PrintRun( uint64_t seed, const WorldStats *s )
+{
+  double n = s->samples ? s->samples : 1;
+  double mean = s->offsetSum / n;
+
+  printf("%llu,%.0f,%.3f,%.1f,%.4f,%u,%u,%u,%u\n",
+         (unsigned long long)seed, s->travelled,
+         s->travelled / 1000.0 / (s->time > 0 ? s->time : 1),
+         sqrt(fabs(s->offsetSqSum / n - mean * mean)),
+         sqrt(s->headingSqSum / n), s->collisions,
+         s->echoes, s->dropouts, s->multipaths);
+}
+
+static int Sweep( WorldConfig *config, double seconds, int runs )
+{
+  WorldStats s;
+  uint64_t first = config->seed;
+  int fd[2];
+  int n;
+  pid_t pid;
+
+  printf("seed,travelled_mm,speed_m_s,offset_sd_mm,heading_rms_rad,"
+         "collisions,echoes,dropouts,multipaths\n");
+  for (n = 0; n < runs; n++)
+  {
+    config->seed = first + n;
+    if (pipe(fd) != 0 || (pid = fork()) < 0)
+    {
+      perror("sim");
+      return 1;
+    }
+    if (pid == 0)
+    {
+      close(fd[0]);
+      RunOnce(config, seconds);
+      if (write(fd[1], WorldGetStats(), sizeof(s)) != sizeof(s))
+      {
+        _exit(1);
+      }
+      _exit(0);
+    }
+    close(fd[1]);
+    if (read(fd[0], &s, sizeof(s)) == sizeof(s))
+    {
+      PrintRun(config->seed, &s);
+    }
+    close(fd[0]);
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
+
+int main( int argc, char **argv )
+{
+  WorldConfig config;
+  const WorldStats *s;
+  double seconds = 30.0;
+  double wall;
+  clock_t start;
+  int runs = 0;
+  int opt;
+  int n;
+
+  WorldDefaults(&config);
+  while ((opt = getopt(argc, argv, "t:s:n:w:y:a:N:D:M:T:V:S:o:d:e:")) != -1)
+  {
+    switch (opt)
+    {
+      case 't': seconds = atof(optarg); break;
+      case 's': config.seed = strtoull(optarg, NULL, 0); break;
+      case 'n': runs = atoi(optarg); break;
+      case 'w': config.corridorWidth = atof(optarg); break;
+      case 'y': config.startY = atof(optarg); break;
+      case 'a': config.startHeading = atof(optarg) * M_PI / 180.0; break;
+      case 'N': config.noiseMm = atof(optarg); break;
+      case 'D': config.dropoutRate = atof(optarg); break;
+      case 'M': config.multipathRate = atof(optarg); break;
+      case 'T': config.airTemp = atof(optarg); break;
+      case 'V': config.batteryMv = atof(optarg); break;
+      case 'S': config.batteryDrain = atof(optarg); break;
+      case 'd':
+        if ((debugOut = fopen(optarg, "wb")) == NULL)
+        {
+          perror(optarg);
+          return 1;
+        }
+        break;
+      case 'e':
+        if ((echoOut = fopen(optarg, "w")) == NULL)
+        {
+          perror(optarg);
+          return 1;
+        }
+        fprintf(echoOut, "cycles,pinger,width\n");
+        break;
+      case 'o':
+        if (boxCount < MAX_BOXES &&
+            sscanf(optarg, "%lf,%lf,%lf", &box[boxCount][0],
+                   &box[boxCount][1], &box[boxCount][2]) == 3)
+        {
+          boxCount++;
+          break;
+        }
+        /* fall through */
+      default:
+        fprintf(stderr, "usage: %s [-t s] [-s seed] [-n runs] [-w mm] "
+                "[-y mm] [-a deg] [-N mm] [-D p] [-M p] [-T C] [-V mV] [-S mV/s] "
+                "[-o x,y,size] [-d file] [-e file]\n",
+                argv[0]);
+        return 2;
+    }
+  }
+
+  if (runs > 0)
+  {
+    if (debugOut != NULL || echoOut != NULL)
+    {
+      fprintf(stderr, "%s: -d and -e record a single run, not a sweep\n",
+              argv[0]);
+      return 2;
+    }
+    return Sweep(&config, seconds, runs);
+  }
+
+  start = clock();
+  RunOnce(&config, seconds);
+  wall = (double)(clock() - start) / CLOCKS_PER_SEC;
+  s = WorldGetStats();
+
+  printf("simulated %.3f s in %.3f s (%.0fx real time)\n",
+         seconds, wall, wall > 0 ? seconds / wall : 0.0);
+  printf("robot: x %.0f y %.0f heading %.1f deg, %u collisions\n",
+         s->x, s->y, s->heading * 180.0 / M_PI, s->collisions);
+  printf("world: %u echoes, %u dropouts, %u multipath\n",
+         s->echoes, s->dropouts, s->multipaths);
+  for (n = 0; n < 3; n++)
+  {
+    printf("pinger %d: %5u mm  edges %5u  timeouts %u  crosstalk %u  cov %u"
+           "  hampel %u\n",
+           n, pinger[n], pulse_count[n], echoTimeoutCount[n],
+           crosstalkCount[n], covCount[n], hampelCount[n]);
+  }
+  printf("motor: %u bytes, %u packets, %u bad, %u timeouts, %u suppressed, "
+         "tx depth max %u, tx overflow %u\n",
+         motorBytes, s->packets, s->badPackets, s->serialTimeouts,
+         motorSuppressedCount, txDepthMax, txOverflowCount);
+  printf("debug: %u telemetry frames skipped, %u bytes dropped\n",
+         telemetrySkipCount, debugOverflowCount);
+  if (debugOut != NULL)
+  {
+    fclose(debugOut);
+  }
+  if (echoOut != NULL)
+  {
+    fclose(echoOut);
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------
+// steer_lut_gen.c - Writes steer_lut.h to stdout: the P+D response of the
+//                   wall-following controller in steer_params.h sampled
+//                   at every (error, rate) bin, plus the 1/dt table used
+//                   to turn an error step into a rate without dividing.
+//------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include "steer_params.h"
+
+#define ERR_HALF  (STEER_ERR_BINS / 2)
+#define RATE_HALF (STEER_RATE_BINS / 2)
+
+static int Delta( double error, double rate )
+{
+  double out = (STEER_KP_Q10 * error + STEER_KD_Q10 * rate) / 1024.0;
+  long d = lround(out);
+
+  if (d > STEER_MAX_DELTA)
+  {
+    d = STEER_MAX_DELTA;
+  }
+  if (d < -STEER_MAX_DELTA)
+  {
+    d = -STEER_MAX_DELTA;
+  }
+  return (int)d;
+}
+
+int main(void)
+{
+  int e, r, dt;
+
+  printf("//------------------------------------------------------------------------\n");
+  printf("// steer_lut.h - GENERATED by host/steer_lut_gen.c from steer_params.h.\n");
+  printf("//               Do not edit; change steer_params.h and run make in host/.\n");
+  printf("//------------------------------------------------------------------------\n");
+  printf("#ifndef STEER_LUT_H\n#define STEER_LUT_H\n\n");
+  printf("#include \"steer_params.h\"\n\n");
+  printf("#if STEER_KP_Q10 != %d || STEER_KD_Q10 != %d || STEER_MAX_DELTA != %d \\\n",
+         STEER_KP_Q10, STEER_KD_Q10, STEER_MAX_DELTA);
+  printf(" || STEER_ERR_SHIFT != %d || STEER_ERR_BINS != %d \\\n",
+         STEER_ERR_SHIFT, STEER_ERR_BINS);
+  printf(" || STEER_RATE_FRAC != %d || STEER_RATE_BINS != %d \\\n",
+         STEER_RATE_FRAC, STEER_RATE_BINS);
+  printf(" || STEER_RECIP_SHIFT != %d || STEER_MAX_DT_TICKS != %d\n",
+         STEER_RECIP_SHIFT, STEER_MAX_DT_TICKS);
+  printf("#error \"steer_lut.h is stale, run make in host/\"\n#endif\n\n");
+
+  // steerLut[error bin][rate bin], bins centred on whole multiples
+  printf("static const int8_t steerLut[STEER_ERR_BINS][STEER_RATE_BINS] =\n{\n");
+  for (e = 0; e < STEER_ERR_BINS; e++)
+  {
+    double error = (double)(e - ERR_HALF) * (1 << STEER_ERR_SHIFT);
+
+    printf("  {");
+    for (r = 0; r < STEER_RATE_BINS; r++)
+    {
+      double rate = (double)(r - RATE_HALF) / (1 << STEER_RATE_FRAC);
+
+      printf("%s%3d", r ? "," : "", Delta(error, rate));
+    }
+    printf("}%s\n", e + 1 < STEER_ERR_BINS ? "," : "");
+  }
+  printf("};\n\n");
+
+  // steerRecip[dt] = 2^STEER_RECIP_SHIFT / dt, entry 0 unused
+  printf("static const uint16_t steerRecip[STEER_MAX_DT_TICKS + 1] =\n{\n");
+  for (dt = 0; dt <= STEER_MAX_DT_TICKS; dt++)
+  {
+    unsigned recip = dt ? (unsigned)lround((double)(1 << STEER_RECIP_SHIFT) / dt) : 0;
+
+    printf("%s%5u%s", dt % 10 == 0 ? "  " : "", recip,
+           dt < STEER_MAX_DT_TICKS ? "," : "");
+    if (dt % 10 == 9 || dt == STEER_MAX_DT_TICKS)
+    {
+      printf("\n");
+    }
+  }
+  printf("};\n\n#endif\n");
+  return 0;
+}
@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------
+// telemetry_decode.c - Turn a capture of the robot's debug channel into
+//                      CSV, one row per telemetry frame (see TelemetryTask
+//                      in main.c). Bytes that are not part of a valid
+//                      frame, such as the text of a profile dump, are
+//                      copied to stderr.
+//
+//   telemetry_decode [capture] > run.csv      (stdin without a file)
+//------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SYNC 0xA5
+#define MIN_PAYLOAD 21                // Fields every frame has
+#define BATTERY_PAYLOAD 23            // Frames with battery mV appended
+#define MAX_PAYLOAD 255
+
+static uint16_t Word( const uint8_t *p )
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static int Checksum( const uint8_t *frame, int payload )
+{
+  uint8_t a = 0;
+  uint8_t b = 0;
+  int n;
+
+  //length byte and payload, as TelemetryByte sums them
+  for (n = 1; n < payload + 2; n++)
+  {
+    a += frame[n];
+    b += a;
+  }
+  return frame[payload + 2] == a && frame[payload + 3] == b;
+}
+
+//fields appended by later firmware are left empty for older frames
+static void PrintFrame( const uint8_t *p, int payload )
+{
+  printf("%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,",
+         p[0], Word(p + 1),
+         Word(p + 3), Word(p + 5), Word(p + 7),
+         Word(p + 9), Word(p + 11), Word(p + 13),
+         p[15], p[16], p[17], p[18], p[19], p[20]);
+  if (payload >= BATTERY_PAYLOAD)
+  {
+    printf("%u", Word(p + 21));
+  }
+  printf("\n");
+}
+
+int main( int argc, char **argv )
+{
+  FILE *in = stdin;
+  uint8_t buf[MAX_PAYLOAD + 4];
+  int have = 0;
+  int payload;
+  int c;
+  unsigned long frames = 0;
+  unsigned long bad = 0;
+  unsigned long lost = 0;
+  int lastSeq = -1;
+
+  if (argc > 1 && (in = fopen(argv[1], "rb")) == NULL)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  printf("seq,tick,width0,width1,width2,pinger0,pinger1,pinger2,"
+         "state,right_motor,left_motor,stops,dodges,turns,battery_mv\n");
+
+  while ((c = fgetc(in)) != EOF)
+  {
+    buf[have++] = (uint8_t)c;
+
+    //resync: drop leading bytes until one could start a frame
+    while (have > 0)
+    {
+      if (buf[0] != SYNC)
+      {
+        fputc(buf[0], stderr);
+      }
+      else if (have < 2 || have < buf[1] + 4)
+      {
+        break;                        // Wait for the rest of the frame
+      }
+      else
+      {
+        payload = buf[1];
+        if (payload >= MIN_PAYLOAD && Checksum(buf, payload))
+        {
+          if (lastSeq >= 0)
+          {
+            lost += (uint8_t)(buf[2] - lastSeq - 1);
+          }
+          lastSeq = buf[2];
+          PrintFrame(buf + 2, payload);
+          frames++;
+          //a false sync can have pulled the next frames in behind this one
+          have -= payload + 4;
+          memmove(buf, buf + payload + 4, have);
+          continue;
+        }
+        bad++;
+      }
+      //not a frame start, shift by one byte
+      for (c = 1; c < have; c++)
+      {
+        buf[c - 1] = buf[c];
+      }
+      have--;
+    }
+  }
+
+  fprintf(stderr, "\n%lu frames, %lu missing, %lu bad syncs\n",
+          frames, lost, bad);
+  return 0;
+}
@@ -0,0 +1,44 @@
+//------------------------------------------------------------------------
+// test.h - Assertions for the host unit tests (make test). Each test
+//          program links the firmware modules against hal_host.c,
+//          calls them directly and exits non-zero on any failure.
+//------------------------------------------------------------------------
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int testChecks;
+static int testFailures;
+
+#define CHECK(cond) \
+  do \
+  { \
+    testChecks++; \
+    if (!(cond)) \
+    { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      testFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do \
+  { \
+    long long actual_ = (long long)(actual); \
+    long long expected_ = (long long)(expected); \
+    testChecks++; \
+    if (actual_ != expected_) \
+    { \
+      fprintf(stderr, "%s:%d: %s = %lld, expected %lld\n", __FILE__, \
+              __LINE__, #actual, actual_, expected_); \
+      testFailures++; \
+    } \
+  } while (0)
+
+//print the tally and give main's return value
+#define TEST_DONE() \
+  (printf("%s: %d checks, %d failed\n", __FILE__, testChecks, testFailures), \
+   testFailures != 0)
+
+#endif
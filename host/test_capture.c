@@ -0,0 +1,320 @@
+//------------------------------------------------------------------------
+// test_capture.c - Unit tests for capture.c: 32-bit capture timestamps
+//                  across timer wraps, the capture queue, overruns, lost
+//                  echoes, crosstalk and the ping rate scheduler.
+//------------------------------------------------------------------------
+#include "test.h"
+#include "hal.h"
+#include "capture.h"
+#include "ranging.h"
+#include "steer_params.h"
+
+//capture.c internals
+void PingRates(void);
+extern uint8_t pingSlots[3];
+extern uint8_t pingPeriod[3];
+extern volatile uint8_t captureHead;
+extern volatile uint8_t captureTail;
+extern volatile uint16_t captureDropCount;
+extern volatile uint16_t covCount[3];
+extern volatile uint16_t echoTimeoutCount[3];
+
+static void TestExtendCapture( void )
+{
+  uint32_t rise;
+  uint32_t fall;
+
+  //just before an overflow, nothing pending
+  CHECK_EQ(ExtendCapture(7, 0xFFFE, 0), 0x0007FFFEUL);
+
+  //just after the wrap, TAIFG still pending: belongs to the next count
+  CHECK_EQ(ExtendCapture(7, 0x0003, 1), 0x00080003UL);
+
+  //captured before the wrap but read with TAIFG already set
+  CHECK_EQ(ExtendCapture(7, 0xFFF0, 1), 0x0007FFF0UL);
+
+  //a pulse whose rise is before the wrap and fall after it, with the
+  //overflow IRQ having run in between or not
+  rise = ExtendCapture(7, 0xFF00, 0);
+  fall = ExtendCapture(7, 0x0100, 1);
+  CHECK_EQ(fall - rise, 0x200);
+  fall = ExtendCapture(8, 0x0100, 0);
+  CHECK_EQ(fall - rise, 0x200);
+
+  //the 16-bit overflow count itself wrapping
+  rise = ExtendCapture(0xFFFF, 0xFFF0, 0);
+  fall = ExtendCapture(0xFFFF, 0x0010, 1);
+  CHECK_EQ(fall - rise, 0x20);
+
+  //TA and TB share a time base; TA's overflow IRQ ran, TB's is still
+  //pending, so their counts disagree but the timestamps must not
+  CHECK_EQ(ExtendCapture(5, 0x0010, 0), ExtendCapture(4, 0x0010, 1));
+  CHECK_EQ(ExtendCapture(5, 0x7FFF, 0), ExtendCapture(4, 0x7FFF, 1));
+}
+
+static void TestQueue( void )
+{
+  uint16_t dropped;
+  uint8_t n;
+
+  RangingInit();
+  CaptureInit();
+
+  //an echo's edges pair into its width and mark it ready
+  TriggerPinger(1);
+  CapturePush(1, CAPTURE_RISING, 1000);
+  CapturePush(1, 0, 6000);
+  CHECK(!(echoReady & 2));
+  ProcessCaptures();
+  CHECK_EQ(cycles[1], 5000);
+  CHECK(echoReady & 2);
+  CHECK(!(waiting & 2));
+  CHECK(TakeEcho(1));
+  CHECK(!TakeEcho(1));
+
+  //a fall with no echo awaited changes the width but is no reading
+  CapturePush(1, CAPTURE_RISING, 7000);
+  CapturePush(1, 0, 7100);
+  ProcessCaptures();
+  CHECK(!(echoReady & 2));
+
+  //edges of the pingers interleave in the queue
+  TriggerPinger(0);
+  TriggerPinger(2);
+  CapturePush(0, CAPTURE_RISING, 10000);
+  CapturePush(2, CAPTURE_RISING, 10100);
+  CapturePush(2, 0, 12100);
+  CapturePush(0, 0, 13000);
+  ProcessCaptures();
+  CHECK_EQ(cycles[0], 3000);
+  CHECK_EQ(cycles[2], 2000);
+  CHECK_EQ(echoReady & 5, 5);
+  TakeEcho(0);
+  TakeEcho(2);
+
+  //a full queue drops the newest edge and counts it
+  dropped = captureDropCount;
+  for (n = 0; n < 16; n++)
+  {
+    CapturePush(0, (n & 1) ? 0 : CAPTURE_RISING, 20000 + n * 100);
+  }
+  CHECK_EQ(captureDropCount, dropped + 1);
+  CHECK_EQ((uint8_t)(captureHead - captureTail) & 15, 15);
+  ProcessCaptures();
+  CHECK_EQ(captureHead, captureTail);
+}
+
+static void TestOverrun( void )
+{
+  uint16_t overruns;
+
+  RangingInit();
+  CaptureInit();
+  overruns = covCount[2];
+
+  //the rise was lost: the fall can't be paired and gives no echo
+  TriggerPinger(2);
+  CapturePush(2, CAPTURE_RISING, 1000);
+  CapturePush(2, CAPTURE_OVERRUN, 5000);
+  ProcessCaptures();
+  CHECK_EQ(covCount[2], overruns + 1);
+  CHECK(!(echoReady & 4));
+  CHECK(waiting & 4);
+
+  //a rise flagged with an overrun still starts the next pair
+  CapturePush(2, CAPTURE_RISING | CAPTURE_OVERRUN, 8000);
+  CapturePush(2, 0, 9500);
+  ProcessCaptures();
+  CHECK_EQ(covCount[2], overruns + 2);
+  CHECK_EQ(cycles[2], 1500);
+  CHECK(echoReady & 4);
+  TakeEcho(2);
+}
+
+//fire a pinger that never hears back and tick until it gives up,
+//give the ticks it took
+static int LostEcho( uint8_t ping_num )
+{
+  int n = 0;
+
+  TriggerPinger(ping_num);
+  while (waiting & (1 << ping_num))
+  {
+    tickCount++;
+    CaptureTick();
+    n++;
+  }
+  return n;
+}
+
+static void TestEchoTimeout( void )
+{
+  uint16_t lost;
+  uint32_t n;
+
+  RangingInit();
+  tickCount = 1000;
+  CaptureInit();
+  lost = echoTimeoutCount[0];
+
+  //nothing heard yet
+  CHECK(!EchoFresh(0));
+
+  //an echo makes the range fresh
+  TriggerPinger(0);
+  CapturePush(0, CAPTURE_RISING, 1000);
+  CapturePush(0, 0, 9000);
+  ProcessCaptures();
+  TakeEcho(0);
+  CHECK(EchoFresh(0));
+
+  //one lost echo is forgiven, open space that keeps them coming is not
+  CHECK_EQ(LostEcho(0), 30);
+  CHECK_EQ(echoTimeoutCount[0], lost + 1);
+  CHECK(!(waiting & 1));
+  CHECK(EchoFresh(0));
+  CHECK_EQ(LostEcho(0), 30);
+  CHECK_EQ(LostEcho(0), 30);
+  CHECK_EQ(LostEcho(0), 30);
+  CHECK(!EchoFresh(0));
+
+  //and stays stale however long it lasts, tickCount wrapping included
+  for (n = 0; n < 70000UL / 30; n++)
+  {
+    LostEcho(0);
+    if (EchoFresh(0))
+    {
+      break;
+    }
+  }
+  CHECK(!EchoFresh(0));
+
+  //the next echo is believed again
+  TriggerPinger(0);
+  CapturePush(0, CAPTURE_RISING, 20000);
+  CapturePush(0, 0, 28000);
+  ProcessCaptures();
+  TakeEcho(0);
+  CHECK(EchoFresh(0));
+}
+
+static void TestCrosstalk( void )
+{
+  uint32_t end = 1000 + US_CYCLES(2400);
+
+  RangingInit();
+  CaptureInit();
+
+  //left fired first, the right's echo ends 50 us after the left's
+  TriggerPinger(1);
+  TriggerPinger(2);
+  CapturePush(1, CAPTURE_RISING, 1000);
+  CapturePush(1, 0, end);
+  CapturePush(2, CAPTURE_RISING, 2000);
+  CapturePush(2, 0, end + US_CYCLES(50));
+  ProcessCaptures();
+  TakeEcho(1);
+  TakeEcho(2);
+
+  //the pinger fired first owns the sound
+  CHECK(!IsCrosstalk(1));
+
+  //nothing to judge the right's width by yet: rejected
+  CHECK(IsCrosstalk(2));
+
+  //well short of where the right wall was: the left's sound ended it
+  pinger[2] = WidthToMm(EchoWidthUs(2)) + 200;
+  CHECK(IsCrosstalk(2));
+
+  //where the right wall was: two real echoes that happen to end together
+  pinger[2] = WidthToMm(EchoWidthUs(2)) + 20;
+  CHECK(!IsCrosstalk(2));
+
+  //short, but ending well apart from the left's: a real echo
+  TriggerPinger(2);
+  CapturePush(2, CAPTURE_RISING, 20000);
+  CapturePush(2, 0, 20000 + US_CYCLES(1000));
+  ProcessCaptures();
+  TakeEcho(2);
+  CHECK(!IsCrosstalk(2));
+}
+
+//the whole PING_SLOTS budget of a window is handed out
+static int AllSlotsUsed( void )
+{
+  return pingSlots[0] + pingSlots[1] + pingSlots[2] == 30;
+}
+
+static void TestPingRates( void )
+{
+  uint8_t calm[3];
+  uint8_t n;
+
+  //on the setpoint with a far front: every pinger at least 4 per window
+  RangingInit();
+  pinger[0] = 3000;
+  pinger[1] = STEER_SETPOINT;
+  pinger[2] = 779;
+  pingerRate[0] = 0;
+  PingRates();
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    CHECK(pingPeriod[n] >= 4 && pingPeriod[n] <= 30);
+    calm[n] = pingPeriod[n];
+  }
+
+  //a near front takes slots from the left, the right follows it at half
+  pinger[0] = 500;
+  PingRates();
+  CHECK(pingPeriod[0] < calm[0]);
+  CHECK(pingPeriod[2] <= calm[2]);
+  CHECK(pingPeriod[0] < pingPeriod[2]);
+  CHECK(pingPeriod[1] > calm[1]);
+  CHECK(AllSlotsUsed());
+
+  //what the shares round off goes to the left while nothing closes...
+  CHECK_EQ(pingSlots[1], 5);
+
+  //closing fast on a far front counts as near
+  pinger[0] = 1400;
+  PingRates();
+  calm[0] = pingPeriod[0];
+  pingerRate[0] = -4 * 256;           // 4 mm/tick, 1 m in 250 ticks
+  PingRates();
+  CHECK(pingPeriod[0] < calm[0]);
+  CHECK(AllSlotsUsed());
+
+  //...and to the front while it does
+  pinger[0] = 500;
+  pingerRate[0] = -1;
+  PingRates();
+  CHECK(pingSlots[0] > 15);
+  CHECK_EQ(pingSlots[1], 4);
+
+  //a wall error takes slots for the left
+  pinger[0] = 3000;
+  pingerRate[0] = 0;
+  pinger[1] = STEER_SETPOINT + 200;
+  PingRates();
+  CHECK(pingPeriod[1] < calm[1]);
+  CHECK(pingPeriod[1] < pingPeriod[0]);
+  CHECK(AllSlotsUsed());
+
+  //no front reading yet is the most urgent
+  pinger[0] = 0;
+  pinger[1] = STEER_SETPOINT;
+  PingRates();
+  CHECK(pingPeriod[0] <= pingPeriod[1] && pingPeriod[0] <= pingPeriod[2]);
+  CHECK(AllSlotsUsed());
+}
+
+int main( void )
+{
+  TestExtendCapture();
+  TestQueue();
+  TestOverrun();
+  TestEchoTimeout();
+  TestCrosstalk();
+  TestPingRates();
+  return TEST_DONE();
+}
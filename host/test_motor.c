@@ -0,0 +1,197 @@
+//------------------------------------------------------------------------
+// test_motor.c - Unit tests for motor.c: Sabertooth packets, the link
+//                start, coalescing into one frame per control period,
+//                keep-alive and battery compensation.
+//------------------------------------------------------------------------
+#include "test.h"
+#include "motor.h"
+
+//motor.c internals
+uint8_t SaberPacket(uint8_t *frame, uint8_t command, uint8_t data);
+extern volatile uint8_t txQueue[16];
+extern volatile uint8_t txHead;
+extern volatile uint8_t txTail;
+extern volatile uint16_t motorSuppressedCount;
+extern volatile uint32_t right_motor;
+extern volatile uint32_t left_motor;
+
+static uint8_t sent[32];
+static uint8_t mark;
+
+//bytes queued since the last call. Host time stands still here, so the
+//UART never drains; read the queue directly and empty it by hand.
+static int Sent( void )
+{
+  int n = 0;
+
+  while (mark != txHead)
+  {
+    sent[n++] = txQueue[mark];
+    mark = (mark + 1) & 15;
+  }
+  txTail = txHead;
+  return n;
+}
+
+static int PacketOk( const uint8_t *p, uint8_t command, uint8_t data )
+{
+  return p[0] == 128 && p[1] == command && p[2] == data &&
+         p[3] == ((p[0] + p[1] + p[2]) & 0x7F);
+}
+
+//a freshly booted link, nothing sent on it yet
+static void LinkUp( void )
+{
+  MotorInit();
+  right_motor = 0;
+  left_motor = 0;
+  mark = txHead;
+  tickCount = 1500;                   // MOTOR_BOOT_TICKS
+  MotorTask();
+  Sent();
+}
+
+static void TestPacket( void )
+{
+  uint8_t frame[4];
+
+  CHECK_EQ(SaberPacket(frame, 6, 100), 4);
+  CHECK(PacketOk(frame, 6, 100));
+  CHECK_EQ(frame[3], (128 + 6 + 100) & 0x7F);
+  SaberPacket(frame, 7, 127);
+  CHECK(PacketOk(frame, 7, 127));
+  CHECK(frame[3] < 0x80);             // Never looks like an address byte
+}
+
+static void TestLinkStart( void )
+{
+  MotorInit();
+  mark = txHead;
+
+  //nothing at all before the Sabertooth has booted
+  tickCount = 100;
+  MotorRequest(0, 40);
+  MotorFlush();
+  MotorTask();
+  CHECK_EQ(Sent(), 0);
+  CHECK_EQ(motorLinkUp, 0);
+
+  //then the bauding byte, the serial timeout and the speeds asked for
+  tickCount = 1500;
+  MotorTask();
+  CHECK_EQ(motorLinkUp, 1);
+  CHECK_EQ(Sent(), 9);
+  CHECK_EQ(sent[0], 0xAA);
+  CHECK(PacketOk(sent + 1, 14, 5));
+  CHECK(PacketOk(sent + 5, 6, 40));
+}
+
+static void TestCoalescing( void )
+{
+  uint16_t suppressed;
+
+  LinkUp();
+
+  //both motors changed by one task: one frame, both packets
+  MotorRequest(0, 40);
+  MotorRequest(1, 44);
+  MotorFlush();
+  CHECK_EQ(Sent(), 8);
+  CHECK(PacketOk(sent, 6, 40));
+  CHECK(PacketOk(sent + 4, 7, 44));
+  CHECK_EQ(MotorCommitted(0), 40);
+  CHECK_EQ(MotorCommitted(1), 44);
+
+  //later changes in the same period wait for its end, only the last
+  //of them goes out
+  MotorRequest(0, 50);
+  MotorFlush();
+  MotorRequest(0, 52);
+  MotorRequest(1, 30);
+  MotorFlush();
+  CHECK_EQ(Sent(), 0);
+  CHECK_EQ(MotorCommitted(0), 40);
+  MotorTask();
+  CHECK_EQ(Sent(), 8);
+  CHECK(PacketOk(sent, 6, 52));
+  CHECK(PacketOk(sent + 4, 7, 30));
+
+  //that frame was the new period's one: a change right after it waits
+  //for the next end too
+  MotorRequest(1, 34);
+  MotorFlush();
+  CHECK_EQ(Sent(), 0);
+  MotorTask();
+  CHECK_EQ(Sent(), 4);
+  CHECK(PacketOk(sent, 7, 34));
+  MotorRequest(1, 30);
+  MotorFlush();
+  CHECK_EQ(Sent(), 0);
+  MotorTask();
+  CHECK_EQ(Sent(), 4);
+
+  //a request for what was last sent is dropped
+  suppressed = motorSuppressedCount;
+  MotorRequest(0, 52);
+  MotorFlush();
+  CHECK_EQ(Sent(), 0);
+  CHECK_EQ(motorSuppressedCount, suppressed + 1);
+
+  //a change that is undone before the period ends never goes out
+  MotorRequest(1, 20);
+  MotorRequest(1, 30);
+  MotorTask();
+  CHECK_EQ(Sent(), 0);
+}
+
+static void TestKeepAlive( void )
+{
+  uint8_t n;
+  int bytes = 0;
+
+  LinkUp();
+  MotorRequest(0, 40);
+  MotorRequest(1, 40);
+  MotorFlush();
+  Sent();
+
+  //unchanged speeds are resent every MOTOR_REFRESH_PERIODS periods
+  for (n = 0; n < 10; n++)
+  {
+    MotorTask();
+    bytes += Sent();
+  }
+  CHECK_EQ(bytes, 8);
+  CHECK(PacketOk(sent, 6, 40));
+  CHECK(PacketOk(sent + 4, 7, 40));
+}
+
+static void TestBattery( void )
+{
+  //10 V: drive 12/10 as far from stop, 88 is 24 steps reverse -> 29
+  LinkUp();
+  BatteryUpdate(620);
+  MotorRequest(0, 88);
+  MotorFlush();
+  CHECK_EQ(Sent(), 4);
+  CHECK(PacketOk(sent, 6, 64 + 29));
+  CHECK_EQ(MotorCommitted(0), 88);    // What was asked for, not sent
+
+  //a full pack is driven as asked
+  LinkUp();
+  BatteryUpdate(744);
+  MotorRequest(0, 88);
+  MotorFlush();
+  CHECK_EQ(Sent(), 4);
+  CHECK(PacketOk(sent, 6, 88));
+}
+
+int main( void )
+{
+  TestPacket();
+  TestLinkStart();
+  TestCoalescing();
+  TestKeepAlive();
+  TestBattery();
+  return TEST_DONE();
+}
@@ -0,0 +1,161 @@
+//------------------------------------------------------------------------
+// test_ranging.c - Unit tests for ranging.c: the Hampel window, the
+//                  alpha-beta tracker and the temperature scaling. Built
+//                  once per RANGE_WINDOW (3, 5 and 7) by host/Makefile.
+//------------------------------------------------------------------------
+#include "test.h"
+#include "ranging.h"
+#include "motor.h"
+
+//ranging.c internals
+uint16_t RangeWindowPush(uint8_t ping_num, uint16_t width);
+uint16_t RangeWindowMad(uint8_t ping_num);
+uint16_t HampelFilter(uint8_t ping_num, uint16_t width);
+uint16_t TrackRange(uint8_t ping_num, uint16_t width, uint16_t seed);
+uint16_t WidthToMm(uint16_t width);
+extern volatile uint16_t hampelCount[3];
+extern volatile uint16_t trackOutlierCount[3];
+extern int32_t trackRate[3];
+extern int16_t airTempQ4;
+
+//the firmware's mm for a width at a temperature, to within Q16 rounding
+static int MmOk( uint16_t width, double celsius )
+{
+  double mm = width * (331.3 + 0.606 * celsius) / 2000.0;
+
+  return WidthToMm(width) >= mm - 1.0 && WidthToMm(width) <= mm + 1.0;
+}
+
+static void TestMad( void )
+{
+  uint8_t n;
+
+  //1000, 1010, ... : deviations 0, 10, 10, 20, 20, 30, 30 from the middle
+  RangingInit();
+  RangeWindowPush(1, 1000);
+  for (n = 1; n < RANGE_WINDOW; n++)
+  {
+    RangeWindowPush(1, 1000 + 10 * n);
+  }
+  CHECK_EQ(RangeWindowMad(1), 10 * ((RANGE_WINDOW / 2 + 1) / 2));
+}
+
+static void TestHampel( void )
+{
+  uint16_t before;
+  uint16_t out;
+  uint8_t replaced;
+  uint8_t n;
+
+  //the first echo fills the window
+  RangingInit();
+  CHECK_EQ(HampelFilter(1, 2000), 2000);
+
+  //a lone spike is replaced by the median
+  before = hampelCount[1];
+  CHECK_EQ(HampelFilter(1, 2600), 2000);
+  CHECK_EQ(hampelCount[1], before + 1);
+
+  //small changes pass straight through
+  CHECK_EQ(HampelFilter(1, 2050), 2050);
+  CHECK_EQ(hampelCount[1], before + 1);
+
+  //a real step is held off until it is the window's majority
+  RangingInit();
+  HampelFilter(2, 2000);
+  replaced = 0;
+  for (n = 0; n < RANGE_WINDOW; n++)
+  {
+    out = HampelFilter(2, 2600);
+    if (out == 2600)
+    {
+      break;
+    }
+    CHECK_EQ(out, 2000);
+    replaced++;
+  }
+  CHECK_EQ(replaced, RANGE_WINDOW / 2);
+}
+
+static void TestTracker( void )
+{
+  uint16_t before;
+  uint16_t width;
+  uint16_t out = 0;
+  uint8_t n;
+
+  //a steady range is held exactly
+  RangingInit();
+  MotorInit();                        // No motion prior, motors never sent
+  tickCount = 1000;
+  CHECK_EQ(TrackRange(0, 3000, 3000), 3000);
+  for (n = 0; n < 5; n++)
+  {
+    tickCount += 10;
+    out = TrackRange(0, 3000, 3000);
+  }
+  CHECK_EQ(out, 3000);
+
+  //a jump past the gate is coasted over, not followed
+  before = trackOutlierCount[0];
+  tickCount += 10;
+  CHECK_EQ(TrackRange(0, 3300, 3300), 3000);
+  tickCount += 10;
+  CHECK_EQ(TrackRange(0, 3300, 3300), 3000);
+  CHECK_EQ(trackOutlierCount[0], before + 2);
+
+  //one more in a row means the scene changed: restart from the seed
+  tickCount += 10;
+  CHECK_EQ(TrackRange(0, 3300, 3300), 3300);
+
+  //a ramp of 1 us/tick is locked onto in rate and range
+  RangingInit();
+  width = 2000;
+  TrackRange(1, width, width);
+  for (n = 0; n < 60; n++)
+  {
+    tickCount += 10;
+    width += 10;
+    out = TrackRange(1, width, width);
+  }
+  CHECK(out + 3 >= width && out <= width + 3);
+  CHECK(trackRate[1] > 256 - 26 && trackRate[1] < 256 + 26);
+
+  //a long gap restarts the track on the new echo
+  tickCount += 1000;
+  CHECK_EQ(TrackRange(1, 5000, 5000), 5000);
+}
+
+static void TestTemperature( void )
+{
+  //20 C until the first reading
+  RangingInit();
+  CHECK(MmOk(1000, 20));
+  CHECK(MmOk(10000, 20));
+
+  //TEMP_ADC_OFFSET reads 0 C, the first reading is taken as is
+  TemperatureUpdate(TEMP_ADC_OFFSET);
+  CHECK_EQ(airTempQ4, 0);
+  CHECK(MmOk(10000, 0));
+
+  //later readings are smoothed: a quarter of the way to 40 C
+  TemperatureUpdate(TEMP_ADC_OFFSET + 97);
+  CHECK(airTempQ4 >= 10 * 16 - 1 && airTempQ4 <= 10 * 16 + 1);
+  CHECK(MmOk(10000, airTempQ4 / 16.0));
+
+  //a broken sensor is clamped, and 0 mm stays "no reading"
+  RangingInit();
+  TemperatureUpdate(1023);
+  CHECK_EQ(airTempQ4, 60 * 16);
+  CHECK_EQ(WidthToMm(0), 1);
+}
+
+int main( void )
+{
+  TestMad();
+  TestHampel();
+  TestTracker();
+  TestTemperature();
+  printf("RANGE_WINDOW %d, ", RANGE_WINDOW);
+  return TEST_DONE();
+}
@@ -0,0 +1,277 @@
+//------------------------------------------------------------------------
+// test_state.c - Unit tests for state.c: the hallway state machine's
+//                transitions on set ranges, with the motor link running
+//                so the dodge spin is timed as on the robot.
+//------------------------------------------------------------------------
+#include "test.h"
+#include "state.h"
+#include "ranging.h"
+#include "motor.h"
+
+//motor.c and capture.c internals
+extern volatile uint8_t txHead;
+extern volatile uint8_t txTail;
+extern volatile uint16_t echoTick[3];
+
+static uint8_t frontLost;            // Front echoes stop coming
+static uint8_t spunRight;
+static uint8_t spunLeft;
+
+//one tick of the main loop, the UART drained as if it kept up and
+//every set range just echoed
+static void Tick( void )
+{
+  uint8_t n;
+
+  tickCount++;
+  for (n = 0; n < 3; n++)
+  {
+    if (pinger[n] != 0 && !(n == 0 && frontLost))
+    {
+      echoTick[n] = tickCount;
+    }
+  }
+  SteeringTask();
+  MotorFlush();
+  if (tickCount % CONTROL_PERIOD_TICKS == 0)
+  {
+    MotorTask();
+  }
+  txTail = txHead;
+
+  if (MotorCommitted(0) == 64 && MotorCommitted(1) == 30)
+  {
+    spunRight = 1;
+  }
+  if (MotorCommitted(0) == 30 && MotorCommitted(1) == 64)
+  {
+    spunLeft = 1;
+  }
+}
+
+//run until the state changes or the ticks run out, give the ticks used
+static int RunWhile( uint8_t state, int limit )
+{
+  int n = 0;
+
+  while (CurrentState == state && n < limit)
+  {
+    Tick();
+    n++;
+  }
+  return n;
+}
+
+static void Ranges( uint16_t front, uint16_t left, uint16_t right )
+{
+  pinger[0] = front;
+  pinger[1] = left;
+  pinger[2] = right;
+}
+
+//robot following the left wall of a 1200 mm hallway
+static void Following( void )
+{
+  MotorInit();
+  RangingInit();
+  StateInit();
+  tickCount = 0;
+  Ranges(2000, 421, 779);
+  RunWhile(STATE_NOP, 3000);
+}
+
+static void TestStart( void )
+{
+  MotorInit();
+  RangingInit();
+  StateInit();
+  tickCount = 0;
+  Ranges(2000, 421, 779);
+
+  //nothing moves before the Sabertooth is up
+  CHECK_EQ(RunWhile(STATE_NOP, 1000), 1000);
+  RunWhile(STATE_NOP, 1000);
+  CHECK_EQ(CurrentState, STATE_FOLLOW);
+  CHECK_EQ(motorLinkUp, 1);
+
+  //a clear hallway keeps it following
+  RunWhile(STATE_FOLLOW, 500);
+  CHECK_EQ(CurrentState, STATE_FOLLOW);
+}
+
+static void TestStopBackup( void )
+{
+  uint8_t stops;
+
+  Following();
+  stops = stopCondition;
+
+  //too close stops, then backs up once the robot has stood
+  pinger[0] = 250;
+  Tick();
+  CHECK_EQ(CurrentState, STATE_STOP);
+  CHECK_EQ(MotorCommitted(0), 64);
+  CHECK_EQ(MotorCommitted(1), 64);
+  CHECK(RunWhile(STATE_STOP, 1000) > 100);
+  CHECK_EQ(CurrentState, STATE_BACKUP);
+
+  //reversing until the front is clear, then back to the wall
+  CHECK_EQ(RunWhile(STATE_BACKUP, 200), 200);
+  pinger[0] = 700;
+  Tick();
+  CHECK_EQ(CurrentState, STATE_FOLLOW);
+  CHECK_EQ(stopCondition, (uint8_t)(stops + 1));
+}
+
+static void TestBackupIntoWall( void )
+{
+  uint8_t stops;
+
+  //reversing into the left wall: dodge what is in front instead
+  Following();
+  stops = stopCondition;
+  pinger[0] = 250;
+  Tick();
+  RunWhile(STATE_STOP, 1000);
+  CHECK_EQ(CurrentState, STATE_BACKUP);
+  Ranges(450, 150, 900);
+  Tick();
+  CHECK_EQ(CurrentState, STATE_DODGE);
+  CHECK_EQ(stopCondition, stops);
+
+  //still too close in front: stand rather than keep reversing
+  Following();
+  pinger[0] = 250;
+  Tick();
+  RunWhile(STATE_STOP, 1000);
+  Ranges(280, 421, 150);
+  Tick();
+  CHECK_EQ(CurrentState, STATE_STOP);
+  RunWhile(STATE_STOP, CONTROL_PERIOD_TICKS);
+  CHECK_EQ(MotorCommitted(0), 64);
+  CHECK_EQ(MotorCommitted(1), 64);
+
+  //backed against something the sides don't see: give up in time
+  Following();
+  pinger[0] = 250;
+  Tick();
+  RunWhile(STATE_STOP, 1000);
+  pinger[0] = 450;
+  CHECK(RunWhile(STATE_BACKUP, 5000) < 5000);
+  CHECK_EQ(CurrentState, STATE_DODGE);
+}
+
+static void TestStaleFront( void )
+{
+  //open space gives no front echo at all, so whatever range was last
+  //left in pinger[] is soon no reason to stop or dodge
+  Following();
+  frontLost = 1;
+  CHECK_EQ(RunWhile(STATE_FOLLOW, 150), 150);
+  pinger[0] = 250;
+  CHECK_EQ(RunWhile(STATE_FOLLOW, 500), 500);
+
+  //nor to keep reversing
+  frontLost = 0;
+  Tick();
+  CHECK_EQ(CurrentState, STATE_STOP);
+  RunWhile(STATE_STOP, 1000);
+  CHECK_EQ(CurrentState, STATE_BACKUP);
+  frontLost = 1;
+  CHECK(RunWhile(STATE_BACKUP, 1000) < 1000);
+  CHECK_EQ(CurrentState, STATE_FOLLOW);
+  frontLost = 0;
+}
+
+static void TestDodge( void )
+{
+  uint8_t dodges;
+
+  Following();
+  dodges = dodgeCondition;
+  spunRight = 0;
+  spunLeft = 0;
+
+  //an obstacle ahead: spin toward the right, which has more room
+  pinger[0] = 600;
+  Tick();
+  CHECK_EQ(CurrentState, STATE_DODGE);
+  CHECK_EQ(RunWhile(STATE_DODGE, 100), 100);
+  CHECK(spunRight);
+  CHECK(!spunLeft);
+
+  //front clear: cross over until the right wall is close
+  pinger[0] = 1500;
+  Tick();
+  CHECK_EQ(CurrentState, STATE_DODGE_CROSS);
+  CHECK_EQ(dodgeCondition, (uint8_t)(dodges + 1));
+  CHECK_EQ(RunWhile(STATE_DODGE_CROSS, CONTROL_PERIOD_TICKS),
+           CONTROL_PERIOD_TICKS);     // Straight from the next frame
+  CHECK_EQ(MotorCommitted(0), MotorCommitted(1));
+  CHECK_EQ(RunWhile(STATE_DODGE_CROSS, 100), 100);
+  Ranges(1500, 960, 240);
+  Tick();
+  CHECK_EQ(CurrentState, STATE_DODGE_SQUARE);
+
+  //spin back by as much as the dodge turned
+  CHECK(RunWhile(STATE_DODGE_SQUARE, 1000) < 1000);
+  CHECK(spunLeft);
+  CHECK_EQ(CurrentState, STATE_DODGE_PASS);
+
+  //the left range falls short beside the obstacle, back to the left
+  //wall as soon as it is behind
+  CHECK_EQ(RunWhile(STATE_DODGE_PASS, 500), 500);
+  Ranges(1500, 500, 240);
+  CHECK_EQ(RunWhile(STATE_DODGE_PASS, 500), 500);
+  Ranges(1500, 960, 240);
+  Tick();
+  CHECK_EQ(CurrentState, STATE_FOLLOW);
+}
+
+static void TestDodgeBlocked( void )
+{
+  int ticks;
+
+  Following();
+  spunRight = 0;
+  spunLeft = 0;
+
+  //a front that never clears: both ways are tried, then stop
+  pinger[0] = 600;
+  Tick();
+  ticks = RunWhile(STATE_DODGE, 5000);
+  CHECK(ticks < 5000);
+  CHECK_EQ(CurrentState, STATE_STOP);
+  CHECK(spunRight);
+  CHECK(spunLeft);
+}
+
+static void TestPassTimeout( void )
+{
+  Following();
+
+  //nothing seen beside us: the pass ends on its own
+  pinger[0] = 600;
+  Tick();
+  RunWhile(STATE_DODGE, 100);
+  pinger[0] = 1500;
+  RunWhile(STATE_DODGE, 10);
+  Ranges(1500, 960, 240);
+  RunWhile(STATE_DODGE_CROSS, 10);
+  RunWhile(STATE_DODGE_SQUARE, 1000);
+  CHECK_EQ(CurrentState, STATE_DODGE_PASS);
+  CHECK(RunWhile(STATE_DODGE_PASS, 5000) < 5000);
+  CHECK_EQ(CurrentState, STATE_FOLLOW);
+}
+
+int main( void )
+{
+  TestStart();
+  TestStopBackup();
+  TestBackupIntoWall();
+  TestStaleFront();
+  TestDodge();
+  TestDodgeBlocked();
+  TestPassTimeout();
+  return TEST_DONE();
+}
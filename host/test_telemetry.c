@@ -0,0 +1,89 @@
+//------------------------------------------------------------------------
+// test_telemetry.c - Runs the firmware's telemetry frames through
+//                    telemetry_decode, behind a false sync whose length
+//                    byte pulls all of them into its buffer at once.
+//------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "hal.h"
+#include "hal_host.h"
+
+#define FRAME 27                      // TELEMETRY_FRAME in main.c
+#define FRAMES 10
+
+static uint8_t captured[FRAME * (FRAMES + 2)];
+static int capturedLen;
+
+static void SaveByte( uint8_t data, uint64_t now )
+{
+  (void)now;
+  if (capturedLen < (int)sizeof captured)
+  {
+    captured[capturedLen++] = data;
+  }
+}
+
+static void TestFalseSync( void )
+{
+  char name[] = "/tmp/test_telemetryXXXXXX";
+  char command[64];
+  char line[256];
+  FILE *out;
+  FILE *decoded;
+  int fd;
+  int rows = -1;                      // Header first
+  unsigned seq;
+  unsigned firstSeq = 0;
+  int inOrder = 1;
+
+  HostSetDebugSink(SaveByte);
+  HostRunFirmware(SMCLK_HZ / 2);
+  CHECK(capturedLen >= FRAME * FRAMES);
+  CHECK_EQ(captured[0], 0xA5);
+
+  fd = mkstemp(name);
+  CHECK(fd >= 0);
+  out = fdopen(fd, "wb");
+  if (out == NULL)
+  {
+    return;
+  }
+  fputc(0xA5, out);                   // Sync with the longest payload
+  fputc(0xFF, out);
+  fwrite(captured, 1, FRAME * FRAMES, out);
+  fclose(out);
+
+  snprintf(command, sizeof command, "./telemetry_decode %s 2>/dev/null",
+           name);
+  decoded = popen(command, "r");
+  CHECK(decoded != NULL);
+  if (decoded == NULL)
+  {
+    remove(name);
+    return;
+  }
+  while (fgets(line, sizeof line, decoded) != NULL)
+  {
+    if (rows >= 0 && sscanf(line, "%u,", &seq) == 1)
+    {
+      if (rows == 0)
+      {
+        firstSeq = seq;
+      }
+      inOrder &= (seq == firstSeq + rows);
+    }
+    rows++;
+  }
+  pclose(decoded);
+  remove(name);
+
+  CHECK_EQ(rows, FRAMES);
+  CHECK(inOrder);
+}
+
+int main( void )
+{
+  TestFalseSync();
+  return TEST_DONE();
+}
@@ -0,0 +1,378 @@
+//------------------------------------------------------------------------
+// world.c - Hallway physics and echo model for the host simulator. All
+//           randomness comes from one seeded generator and time only
+//           advances through WorldStep, so a run is fully repeatable.
+//------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+#include "hal.h"
+#include "world.h"
+
+#define SOUND_MM_PER_S_0C 331300.0
+#define NOMINAL_MV 12000.0            // Pack voltage maxWheelSpeed is quoted at
+#define BEAM_RAYS 7                   // Rays cast across each beam
+#define STEP_S 0.001                  // Longest physics step
+#define SABER_ADDRESS 128             // Packetized serial, see motor.c
+#define SABER_BAUDING 0xAA
+
+static WorldConfig cfg;
+static WorldStats stats;
+static WorldWall walls[WORLD_MAX_WALLS];
+static uint8_t wallCount;
+
+static uint8_t command[2];            // Sabertooth speed, 64 = stop
+static uint8_t commanded;             // Bit per motor ever set
+static uint8_t bauded;                // Bauding byte seen, packets accepted
+static uint8_t packet[4];
+static uint8_t packetLength;
+static double serialTimeout;          // s, 0 = off
+static double lastPacket;             // stats.time of the last good packet
+static double wheel[2];               // Actual wheel speeds (mm/s), 0 = right
+static uint64_t rng;
+static uint64_t lastCycles;
+static double soundMmPerS;
+
+//pinger mounting angles: front, left, right
+static const double mountAngle[3] = { 0.0, M_PI / 2, -M_PI / 2 };
+
+static uint64_t NextRandom( void )
+{
+  //xorshift64*
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return rng * 2685821657736338717ULL;
+}
+
+static double Uniform( void )
+{
+  return (double)(NextRandom() >> 11) / 9007199254740992.0;
+}
+
+static double Gaussian( void )
+{
+  double u1 = Uniform();
+  double u2 = Uniform();
+  if (u1 < 1e-12)
+  {
+    u1 = 1e-12;
+  }
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static void AddWall( double x1, double y1, double x2, double y2 )
+{
+  if (wallCount == WORLD_MAX_WALLS)
+  {
+    return;
+  }
+  walls[wallCount].x1 = x1;
+  walls[wallCount].y1 = y1;
+  walls[wallCount].x2 = x2;
+  walls[wallCount].y2 = y2;
+  wallCount++;
+}
+
+void WorldDefaults( WorldConfig *config )
+{
+  memset(config, 0, sizeof(*config));
+  config->corridorLength = 30000.0;
+  config->corridorWidth = 1200.0;
+  config->startY = 0.0;
+  config->startHeading = 0.0;
+  config->wheelBase = 300.0;
+  config->maxWheelSpeed = 800.0;
+  config->motorTau = 0.15;
+  config->batteryMv = NOMINAL_MV;
+  config->batteryDrain = 0.0;
+  config->robotRadius = 150.0;
+  config->beamHalfAngle = 15.0 * M_PI / 180.0;
+  config->maxRange = 4000.0;
+  config->noiseMm = 5.0;
+  config->dropoutRate = 0.01;
+  config->multipathRate = 0.01;
+  config->multipathMaxMm = 1500.0;
+  config->airTemp = 20.0;
+  config->seed = 1;
+}
+
+void WorldInit( const WorldConfig *config )
+{
+  double half;
+
+  cfg = *config;
+  memset(&stats, 0, sizeof(stats));
+  wallCount = 0;
+  command[0] = 64;
+  command[1] = 64;
+  commanded = 0;
+  bauded = 0;
+  packetLength = 0;
+  serialTimeout = 0.0;
+  lastPacket = 0.0;
+  wheel[0] = 0.0;
+  wheel[1] = 0.0;
+  lastCycles = 0;
+  soundMmPerS = SOUND_MM_PER_S_0C * sqrt(1.0 + cfg.airTemp / 273.15);
+  rng = cfg.seed ? cfg.seed : 0x9E3779B97F4A7C15ULL;
+
+  half = cfg.corridorWidth / 2;
+  AddWall(-1000.0, half, cfg.corridorLength, half);        // Left wall
+  AddWall(-1000.0, -half, cfg.corridorLength, -half);      // Right wall
+  AddWall(cfg.corridorLength, -half, cfg.corridorLength, half);
+  AddWall(-1000.0, -half, -1000.0, half);
+
+  stats.x = 0.0;
+  stats.y = cfg.startY;
+  stats.heading = cfg.startHeading;
+}
+
+uint8_t WorldAddBox( double x, double y, double size )
+{
+  double h = size / 2;
+
+  if (wallCount + 4 > WORLD_MAX_WALLS)
+  {
+    return 0;
+  }
+  AddWall(x - h, y - h, x + h, y - h);
+  AddWall(x + h, y - h, x + h, y + h);
+  AddWall(x + h, y + h, x - h, y + h);
+  AddWall(x - h, y + h, x - h, y - h);
+  return 1;
+}
+
+static double RayCast( double ox, double oy, double angle )
+{
+  double dx = cos(angle);
+  double dy = sin(angle);
+  double best = INFINITY;
+  double ex, ey, den, t, u;
+  uint8_t n;
+
+  for (n = 0; n < wallCount; n++)
+  {
+    ex = walls[n].x2 - walls[n].x1;
+    ey = walls[n].y2 - walls[n].y1;
+    den = dx * ey - dy * ex;
+    if (fabs(den) < 1e-12)
+    {
+      continue;
+    }
+    t = ((walls[n].x1 - ox) * ey - (walls[n].y1 - oy) * ex) / den;
+    u = ((walls[n].x1 - ox) * dy - (walls[n].y1 - oy) * dx) / den;
+    if (t > 0.0 && u >= 0.0 && u <= 1.0 && t < best)
+    {
+      best = t;
+    }
+  }
+  return best;
+}
+
+static double WallDistance( double px, double py, const WorldWall *w )
+{
+  double ex = w->x2 - w->x1;
+  double ey = w->y2 - w->y1;
+  double len = ex * ex + ey * ey;
+  double u = len > 0 ? ((px - w->x1) * ex + (py - w->y1) * ey) / len : 0;
+
+  if (u < 0)
+  {
+    u = 0;
+  }
+  if (u > 1)
+  {
+    u = 1;
+  }
+  return hypot(px - (w->x1 + u * ex), py - (w->y1 + u * ey));
+}
+
+uint32_t WorldEcho( uint8_t ping_num, uint64_t now )
+//------------------------------------------------------------------------
+// Func:  Echo width for a pinger triggered now: the nearest wall inside
+//        the beam, plus noise, or a dropout / longer multipath path
+//------------------------------------------------------------------------
+{
+  double angle = stats.heading + mountAngle[ping_num];
+  double range = INFINITY;
+  double r;
+  uint8_t n;
+
+  WorldStep(now);
+
+  for (n = 0; n < BEAM_RAYS; n++)
+  {
+    r = RayCast(stats.x, stats.y,
+                angle + cfg.beamHalfAngle * (2.0 * n / (BEAM_RAYS - 1) - 1.0));
+    if (r < range)
+    {
+      range = r;
+    }
+  }
+
+  if (range > cfg.maxRange || Uniform() < cfg.dropoutRate)
+  {
+    stats.dropouts++;
+    return 0;
+  }
+  if (Uniform() < cfg.multipathRate)
+  {
+    stats.multipaths++;
+    range += Uniform() * cfg.multipathMaxMm;
+  }
+  range += Gaussian() * cfg.noiseMm;
+  if (range < 20.0)
+  {
+    range = 20.0;
+  }
+
+  stats.echoes++;
+  return (uint32_t)(range * 2.0 / soundMmPerS * SMCLK_HZ);
+}
+
+void WorldUartByte( uint8_t data, uint64_t now )
+//------------------------------------------------------------------------
+// Func:  Decode the Sabertooth packetized serial protocol: nothing is
+//        taken before the bauding byte, then address, command, data and
+//        a 7-bit checksum. Commands 6/7 drive motor 1/2 (64 = stop) and
+//        14 sets the serial timeout.
+//------------------------------------------------------------------------
+{
+  WorldStep(now);
+
+  if (!bauded)
+  {
+    bauded = (data == SABER_BAUDING);
+    return;
+  }
+  //the address is the only byte with bit 7 set, so it resyncs
+  if (data & 0x80)
+  {
+    if (packetLength != 0)
+    {
+      stats.badPackets++;
+    }
+    packetLength = 0;
+  }
+  else if (packetLength == 0)
+  {
+    stats.badPackets++;
+    return;
+  }
+  packet[packetLength++] = data;
+  if (packetLength < 4)
+  {
+    return;
+  }
+  packetLength = 0;
+
+  if (packet[0] != SABER_ADDRESS ||
+      ((packet[0] + packet[1] + packet[2]) & 0x7F) != packet[3])
+  {
+    stats.badPackets++;
+    return;
+  }
+  switch (packet[1])
+  {
+    case 6:
+    case 7:
+      command[packet[1] - 6] = packet[2];
+      commanded |= 1 << (packet[1] - 6);
+      break;
+    case 14:
+      serialTimeout = packet[2] * 0.1;
+      break;
+    default:
+      stats.badPackets++;
+      return;
+  }
+  stats.packets++;
+  lastPacket = stats.time;
+}
+
+static double WheelTarget( uint8_t motor )
+{
+  if (!(commanded & (1 << motor)))
+  {
+    return 0.0;
+  }
+  //this robot's motors are wired so commands below 64 drive forward,
+  //and the Sabertooth's output is a duty cycle of the pack voltage
+  return (64.0 - command[motor]) / 63.0 * cfg.maxWheelSpeed *
+         WorldBatteryMv() / NOMINAL_MV;
+}
+
+static void Integrate( double dt )
+{
+  double k = 1.0 - exp(-dt / cfg.motorTau);
+  double v, w, x0, y0;
+  uint8_t n;
+
+  if (serialTimeout > 0.0 && stats.time - lastPacket > serialTimeout &&
+      commanded != 0)
+  {
+    stats.serialTimeouts++;
+    commanded = 0;                    // Sabertooth stops both motors
+  }
+  wheel[0] += (WheelTarget(0) - wheel[0]) * k;
+  wheel[1] += (WheelTarget(1) - wheel[1]) * k;
+
+  v = (wheel[0] + wheel[1]) / 2;
+  w = (wheel[0] - wheel[1]) / cfg.wheelBase;   // Right faster turns left
+
+  x0 = stats.x;
+  y0 = stats.y;
+  stats.x += v * cos(stats.heading) * dt;
+  stats.y += v * sin(stats.heading) * dt;
+  stats.heading += w * dt;
+
+  for (n = 0; n < wallCount; n++)
+  {
+    if (WallDistance(stats.x, stats.y, &walls[n]) < cfg.robotRadius)
+    {
+      //stuck against the wall until the firmware backs away
+      stats.collisions++;
+      stats.x = x0;
+      stats.y = y0;
+      wheel[0] = 0.0;
+      wheel[1] = 0.0;
+      break;
+    }
+  }
+
+  stats.travelled = stats.x;
+  stats.time += dt;
+  stats.offsetSum += stats.y;
+  stats.offsetSqSum += stats.y * stats.y;
+  stats.headingSqSum += stats.heading * stats.heading;
+  stats.samples++;
+}
+
+void WorldStep( uint64_t now )
+{
+  double dt;
+
+  if (now <= lastCycles)
+  {
+    return;
+  }
+  dt = (double)(now - lastCycles) / SMCLK_HZ;
+  lastCycles = now;
+
+  while (dt > STEP_S)
+  {
+    Integrate(STEP_S);
+    dt -= STEP_S;
+  }
+  Integrate(dt);
+}
+
+double WorldBatteryMv( void )
+{
+  return cfg.batteryMv - cfg.batteryDrain * stats.time;
+}
+
+const WorldStats *WorldGetStats( void )
+{
+  return &stats;
+}
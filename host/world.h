@@ -0,0 +1,74 @@
+//------------------------------------------------------------------------
+// world.h - Deterministic 2D hallway for the host simulator: a
+//           differential-drive robot driven by the Sabertooth bytes the
+//           firmware sends, corridor walls and box obstacles, and
+//           ultrasonic echoes with noise, dropouts and multipath.
+//------------------------------------------------------------------------
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "stdint.h"
+
+#define WORLD_MAX_WALLS 64
+
+typedef struct
+{
+  double x1, y1, x2, y2;              // Segment end points (mm)
+} WorldWall;
+
+typedef struct
+{
+  //geometry, x runs down the hallway and y = 0 is its centre line
+  double corridorLength;              // mm, a wall closes the far end
+  double corridorWidth;               // mm
+  double startY;                      // Start offset from the centre line
+  double startHeading;                // rad, 0 = straight down the hall
+
+  //drive train
+  double wheelBase;                   // mm between the wheels
+  double maxWheelSpeed;               // mm/s at full command
+  double motorTau;                    // s, first-order motor response
+  double batteryMv;                   // Motor pack at the start of the run
+  double batteryDrain;                // mV/s the pack drops while running
+  double robotRadius;                 // mm, touching a wall is a collision
+
+  //pingers
+  double beamHalfAngle;               // rad
+  double maxRange;                    // mm, no echo past this
+  double noiseMm;                     // Gaussian range noise (1 sigma)
+  double dropoutRate;                 // Chance an echo never comes back
+  double multipathRate;               // Chance an echo takes a longer path
+  double multipathMaxMm;              // Longest extra path of a multipath echo
+  double airTemp;                     // C, sets the speed of sound
+
+  uint64_t seed;
+} WorldConfig;
+
+typedef struct
+{
+  double time;                        // s
+  double x, y, heading;
+  double travelled;                   // mm along the hall
+  uint32_t collisions;
+  double offsetSum;                   // Sum of y samples
+  double offsetSqSum;                 // Sum of y^2 samples
+  double headingSqSum;                // Sum of heading^2 samples
+  uint32_t samples;
+  uint32_t echoes, dropouts, multipaths;
+  uint32_t packets, badPackets;       // Sabertooth packets taken / rejected
+  uint32_t serialTimeouts;            // Motors stopped by the serial timeout
+} WorldStats;
+
+void WorldDefaults(WorldConfig *config);
+void WorldInit(const WorldConfig *config);
+uint8_t WorldAddBox(double x, double y, double size);
+
+//hooks for hal_host.h
+uint32_t WorldEcho(uint8_t ping_num, uint64_t now);
+void WorldUartByte(uint8_t data, uint64_t now);
+void WorldStep(uint64_t now);
+double WorldBatteryMv(void);          // Motor pack voltage now
+
+const WorldStats *WorldGetStats(void);
+
+#endif
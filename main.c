@@ -1,548 +1,576 @@
-#include "msp430x22x4.h"
 #include "stdint.h"
+#include "hal.h"
+#include "robot.h"
+#include "capture.h"
+#include "ranging.h"
+#include "motor.h"
+#include "state.h"
+#include "profile.h"
 
-#define CLK 1200000
-#define MAX_TICKS 2000        // Blink length (loop passes)
-#define MAX_RANGE 300
-
-volatile uint16_t pulse_count[3];      //Global Pulse Count
-volatile float dist[3];             //Global Frequency
-volatile uint32_t fallingEdge[3];
-volatile uint32_t risingEdge[3];
-volatile uint32_t i;
-volatile uint16_t cycles[3];
-volatile uint8_t edge[3];
-volatile float pinger[3];
-volatile float history[9];
-volatile uint8_t waiting;
-volatile uint32_t left_motor;
-volatile uint32_t right_motor;
-
-volatile uint8_t stopCondition;
-volatile uint8_t dodgeCondition;
-
-// STATE MACHINE VARIBLES //
-volatile uint8_t CurrentState;
-volatile uint8_t TurnCounter;
-
-void TimerReadPinger( uint8_t ping_num )
+// SCHEDULER TIMING (1 tick = 1 ms) //
+#define STARTUP_TICKS 70              // Settle time before the first ping
+
+// ADC10 READINGS (temperature and motor battery, see hal.h) //
+#define ADC_PERIOD_TICKS 50           // One conversion per period
+#define TEMP_PERIODS 20               // ADC periods per temperature read (1 s)
+
+// ADC10 VARIABLES //
+volatile uint16_t adcRaw[2];          // Latest reading per ADC_xxx, set by the ISR
+volatile uint8_t adcReady;            // Bit per ADC_xxx not folded in yet
+uint8_t adcTempWait;                  // ADC periods until the next temperature
+
+// DEBUG TX QUEUE (software UART, see hal.h) //
+#define DEBUG_QUEUE_SIZE 64           // Must be a power of two
+#define DEBUG_QUEUE_MASK (DEBUG_QUEUE_SIZE - 1)
+
+volatile uint8_t debugQueue[DEBUG_QUEUE_SIZE];
+volatile uint8_t debugHead;           // Next free slot, written by main
+volatile uint8_t debugTail;           // Next byte to send, written by ISR
+volatile uint16_t debugOverflowCount; // Bytes dropped on a full queue
+
+// TELEMETRY (binary frames on the debug channel) //
+//sync, payload length, payload, then a UBX-style 8-bit Fletcher
+//checksum over length and payload. Fields are little-endian and only
+//ever appended; host/telemetry_decode.c reads them back.
+#define TELEMETRY_SYNC 0xA5
+#define TELEMETRY_PAYLOAD 23
+#define TELEMETRY_FRAME (TELEMETRY_PAYLOAD + 4)
+#if DEBUG_BAUD >= 38400
+#define TELEMETRY_PERIOD_TICKS 10     // Frame period, see the check below
+#else
+#define TELEMETRY_PERIOD_TICKS 30
+#endif
+#if TELEMETRY_FRAME * 10L * 1000 > DEBUG_BAUD * TELEMETRY_PERIOD_TICKS
+#error "telemetry frames don't fit the debug channel at this period"
+#endif
+
+uint8_t telemetrySeq;                 // Frame count, gaps = skipped frames
+uint8_t telemetrySumA;
+uint8_t telemetrySumB;
+volatile uint16_t telemetrySkipCount; // Frames skipped for lack of room
+
+#ifdef PROFILE
+// PROFILE RECORDS //
+#define PROFILE_LINE_MAX 48           // Longest dump line
+#define PROFILE_IDLE 0xFF             // profileDumpNext when not dumping
+
+typedef struct
 {
-  uint32_t cur_ccr_val = TACCR0;
-  //fetch the correct value based on ping_num
-  if (ping_num == 0)
-  {
-    cur_ccr_val = TACCR0;
-  }
-  else if (ping_num == 1)
-  {
-    cur_ccr_val = TACCR1;
-  }
-  else if ( ping_num == 2)
-  {
-    cur_ccr_val = TBCCR0;
-  }
+  uint16_t min;
+  uint16_t max;
+  uint32_t total;                     // For the mean, halved with count
+  uint16_t count;
+} ProfileStats;
+
+ProfileStats profileStats[PROFILE_PROBES];
+uint16_t profileOverhead;             // Cycles of an empty START/STOP
+volatile uint8_t profileDumpNext;     // 0 = header, n = probe n-1
+
+const char * const profileNames[PROFILE_PROBES] =
+{
+  "timer_read", "calc_dist", "hampel", "track", "correction", "motor",
+  "isr_ta0", "isr_ta1", "isr_tb0", "isr_tb1", "isr_uart", "isr_adc",
+  "isr_port1"
+};
+#endif
+
+// SCHEDULER VARIABLES //
+typedef struct
+{
+  void (*Run)(void);                  // Task body
+  uint16_t period;                    // Ticks between releases
+  uint16_t countdown;                 // Ticks until the next release
+  volatile uint8_t ready;             // Released and waiting to run
+} Task;
+
+void TelemetryTask(void);
+void DebugTask(void);
+void AdcTask(void);
+
+//in TASK_TABLE order (robot.h), which is also the run order
+#define TASK_ENTRY(id, run, period, first) { run, period, first, 0 },
+Task tasks[NUM_TASKS] =
+{
+  TASK_TABLE(TASK_ENTRY)
+};
+
+volatile uint16_t tickCount;
+volatile uint8_t delayActive;
+
+uint8_t SchedulerTick(void)
+//------------------------------------------------------------------------
+// Func:  Advance the tick count and release due tasks
+// Args:  None
+// Retn:  1 if the main loop has work to do and must be woken, else 0
+//------------------------------------------------------------------------
+{
+  uint8_t t;
+  uint8_t wake = delayActive;
   
-  //increase the count of total echos we've seen
-  pulse_count[ping_num] += 1;
-   
-  //rising edge
-  if (edge[ping_num] == 0)
+  tickCount++;
+  
+  //echo timeouts and echoes waiting for a crosstalk partner
+  if (CaptureTick())
   {
-    risingEdge[ping_num] = cur_ccr_val;
+    wake = 1;
   }
-  //falling edge
-  else
+  
+  for (t = 0; t < NUM_TASKS; t++)
   {
-    fallingEdge[ping_num] = cur_ccr_val;
-    if ( fallingEdge[ping_num] < risingEdge[ping_num] )
+    //event-only tasks are released by their IRQ
+    if (tasks[t].period == 0)
     {
-          cycles[ping_num] = ( 0xFFFFFFFF - risingEdge[ping_num] ) + fallingEdge[ping_num]; //find the cycles to max and then add our current count
+      continue;
     }
-    //not rollover
-    else
+    if (--tasks[t].countdown == 0)
     {
-          cycles[ping_num] = fallingEdge[ping_num] - risingEdge[ping_num]; //get the number of cycles that have elapsed
+      tasks[t].countdown = tasks[t].period;
+      tasks[t].ready = 1;
+      wake = 1;
     }
   }
-    
-  edge[ping_num] = !edge[ping_num];
-  
-  if (ping_num != 2)
-  {
-    TACTL &= 0xFFFE; 				  //reset irq value
-  }
-  else
-  {
-    TBCTL &= 0xFFFE; 				  //reset irq valu
-  }
   
+  return wake;
 }
 
-#pragma vector=TIMERA0_VECTOR
-__interrupt void Isrtimera0 (void)
+void SchedulerRelease(uint8_t task)
 {
-  TimerReadPinger( 0 );
-  waiting = 0;
+  tasks[task].ready = 1;
 }
 
-#pragma vector=TIMERB0_VECTOR
-__interrupt void Isrtimerb0 (void)
+uint8_t TasksReady(void)
 {
-  //P1OUT |= 0x01;
-  //TimerReadPinger( 0 );
-  waiting = 0;
+  uint8_t t;
+  for (t = 0; t < NUM_TASKS; t++)
+  {
+    if (tasks[t].ready)
+    {
+      return 1;
+    }
+  }
+  return 0;
 }
 
-#pragma vector=TIMERA1_VECTOR
-__interrupt void IsrCntPulseTACC1 (void) 
-//--------------------------------------------------------------------------
-// Func:  At TACCR1 IRQ, increm pulse count & toggle built-in Red LED 
+void RunReadyTasks(void)
+//------------------------------------------------------------------------
+// Func:  Run every released task once, highest priority first
 // Args:  None
 // Retn:  None
-//--------------------------------------------------------------------------
-{ 
-  switch (__even_in_range(TAIV, 10))  // I.D. source of TA IRQ
-  {                 
-    case TAIV_TACCR1:                 // handle chnl 1 IRQ
-        TimerReadPinger( 1 );
-        waiting = 0;
-      break;
-    case TAIV_TACCR2:                 // ignore chnl 2 IRQ
-    case TAIV_TAIFG:                  // ignore TAR rollover IRQ
-    default:                          // ignore everything else
-      break;
+//------------------------------------------------------------------------
+{
+  uint8_t t;
+  for (t = 0; t < NUM_TASKS; t++)
+  {
+    if (tasks[t].ready)
+    {
+      tasks[t].ready = 0;
+      tasks[t].Run();
+    }
   }
-  
+  MotorFlush();
 }
 
-uint8_t MotorController (uint8_t MotorSelect, uint8_t MotorSpeed)
+void DelayTicks(uint16_t ticks)
 //------------------------------------------------------------------------
-// Func:  Easy Motor Controller
-// Args:  uint8_t MotorSelect (0 = Motor 1, 1 = Motor 2)
-//        uint8_t MotorSpeed (1 = Full Reverse, 64 = Stop, 127 = Full Forward)
-// Retn:  0 Successful Exit
-//        1 Motor Select Failure (Something other than 0 or 1 sent in)
+// Func:  Sleep in LPM for the given number of scheduler ticks
+// Args:  ticks = number of 1 ms ticks to wait
+// Retn:  None
 //------------------------------------------------------------------------
 {
-    if((MotorSelect == 0) || (MotorSelect == 1))
+  uint16_t start = tickCount;
+  delayActive = 1;
+  while ((uint16_t)(tickCount - start) < ticks)
+  {
+    HalSleep();                       // woken by the next tick
+    
+    //keep motor output flowing while the caller is blocked
+    if (tasks[MOTOR_TASK].ready)
     {
-      if(MotorSelect == 0)
-      {
-        while ( !(IFG2 & UCA0TXIFG)) {};    // Confirm that Tx Buff is empty
-	UCA0TXBUF = MotorSpeed;             // Set motor speed to inputted speed
-        right_motor = MotorSpeed;
-			  
-	return 0;
-      }
-      else
-      {
-        while ( !(IFG2 & UCA0TXIFG)) {};    // Confirm that Tx Buff is empty
-	UCA0TXBUF = MotorSpeed + 128;       // Inputted motor speed
-        left_motor = MotorSpeed;
-	return 0;
-      }
-    }
-    else
-    {
-      return 1;
+      tasks[MOTOR_TASK].ready = 0;
+      MotorTask();
     }
+  }
+  delayActive = 0;
 }
 
-float VoteForPinger( uint8_t ping_num )
+uint8_t DebugTxFree(void)
 {
-  float diff1 = history[ping_num*3] - history[ping_num*3+1];
-  float diff2 = history[ping_num*3+1] - history[ping_num*3+2];
-  float diff3 = history[ping_num*3] - history[ping_num*3+2];
-  
-  if (diff1 < 0)
-  {
-    diff1 = diff1 * -1;
-  }
+  return (debugTail - debugHead - 1) & DEBUG_QUEUE_MASK;
+}
+
+uint8_t DebugTxEnqueue(uint8_t data)
+//------------------------------------------------------------------------
+// Func:  Queue a byte for the debug channel. It never carries motor
+//        commands, so a full queue only costs debug output.
+// Args:  data = byte to send
+// Retn:  0 Successful Exit
+//        1 Queue full, byte dropped and counted in debugOverflowCount
+//------------------------------------------------------------------------
+{
+  uint8_t next = (debugHead + 1) & DEBUG_QUEUE_MASK;
   
-  if (diff2 < 0)
+  if (next == debugTail)
   {
-    diff2 = diff2 * -1;
+    debugOverflowCount++;
+    return 1;
   }
   
-  if (diff3 < 0)
+  debugQueue[debugHead] = data;
+  debugHead = next;                     // Publish before starting the IRQ
+  HalDebugTxStart();
+  return 0;
+}
+
+uint8_t DebugTxNext(uint8_t *data)
+{
+  if (debugTail == debugHead)
   {
-    diff3 = diff3 * -1;
+    return 0;
   }
   
-  if ( diff1 < diff2 && diff1 < diff3 )
-  {
-    return history[ping_num*3];
-  }
-  else if ( diff2 < diff1 && diff2 < diff3 )
-  {
-    return history[ping_num*3+1];
-  }
-  else if ( diff3 < diff1 && diff3 < diff2 )
+  *data = debugQueue[debugTail];
+  debugTail = (debugTail + 1) & DEBUG_QUEUE_MASK;
+  return 1;
+}
+
+int16_t Clamp16( int32_t value, int16_t limit )
+{
+  if (value > limit)
   {
-    return history[ping_num*3+2];
+    return limit;
   }
-  else
+  if (value < -limit)
   {
-    return pinger[ping_num];
+    return -limit;
   }
+  return (int16_t)value;
 }
 
-void CalculateDist( uint8_t ping_num )
+void SetupBasicFunc (void)
+//------------------------------------------------------------------------
+// Func:  Reset every module and the debug channel, then enable IRQs
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
 {
-  //dist[ping_num] = (float)cycles[ping_num] / (float)CLK;
-  //dist[ping_num] = dist[ping_num] * 1000000;
-  //dist[ping_num] = dist[ping_num] / 12;
-  //dist[ping_num] = dist[ping_num] / 148.;
-  //dist[ping_num] = cycles[ping_num] / 177.6;
+  MotorInit();                          // Motors stay stopped until MotorTask
+  RangingInit();
+  CaptureInit();                        // After RangingInit, reads pinger[]
+  StateInit();
+  adcReady = 0;
+  adcTempWait = 1;                      // Temperature first
   
-  float dif = pinger[ping_num] - dist[ping_num];
-  if (dif < 0)
-  {
-    dif = dif * -1;
-  }
+  debugHead = 0;
+  debugTail = 0;
+  telemetrySeq = 0;
+  telemetrySkipCount = 0;
+#ifdef PROFILE
+  ProfileReset();
+#endif
   
- // if (dist[ping_num] > 100 || dist[ping_num] < 1)
-  //{
-    //return;
-  //}
+  HalEnableIrq();                        // IRQs enab
+}
+
+#ifdef PROFILE
+void ProfileReset(void)
+//------------------------------------------------------------------------
+// Func:  Clear the records and measure what an empty START/STOP pair
+//        costs, which ProfileRecord takes off every sample
+//------------------------------------------------------------------------
+{
+  uint8_t n;
+  uint16_t start;
   
-  //update the history
-  history[ping_num*3] = history[ping_num*3+1];
-  history[ping_num*3+1] = history[ping_num*3+2];
-  history[ping_num*3+2] = cycles[ping_num];
+  for (n = 0; n < PROFILE_PROBES; n++)
+  {
+    profileStats[n].min = 0xFFFF;
+    profileStats[n].max = 0;
+    profileStats[n].total = 0;
+    profileStats[n].count = 0;
+  }
+  profileDumpNext = PROFILE_IDLE;
   
-  pinger[ping_num] = VoteForPinger(ping_num);
+  start = HalCycleTimer();
+  profileOverhead = HalCycleTimer() - start;
+}
+
+void ProfileRecord(uint8_t probe, uint16_t cycles)
+//------------------------------------------------------------------------
+// Func:  Add one timed run of a probe, called from main and ISRs. Each
+//        probe only runs in one context, so no locking is needed.
+// Args:  probe = PROFILE_xxx, cycles = timer counts from START to STOP
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  ProfileStats *stats = &profileStats[probe];
   
-  /*if (dif > 10 && dif < MAX_RANGE && pinger[ping_num] != 0 )
+  cycles = (cycles > profileOverhead) ? cycles - profileOverhead : 0;
+  if (cycles < stats->min)
   {
-    pinger[ping_num] = pinger[ping_num];
+    stats->min = cycles;
   }
-  else
+  if (cycles > stats->max)
+  {
+    stats->max = cycles;
+  }
+  stats->total += cycles;
+  
+  //halving both keeps the mean and weights recent runs more
+  if (++stats->count == 0xFFFF)
   {
-    pinger[ping_num] = dist[ping_num];
-  }*/
+    stats->count >>= 1;
+    stats->total >>= 1;
+  }
 }
 
-void StartPinger( uint8_t ping_num )
+void ProfileDumpRequest(void)
 {
-  //left
-  if (ping_num == 1)
+  if (profileDumpNext == PROFILE_IDLE)
   {
-    P2OUT |= 0x01;                          // Set Pin High P2.0
+    profileDumpNext = 0;
   }
-  //front
-  if (ping_num == 0)
+}
+
+void DebugTxString(const char *text)
+{
+  while (*text)
   {
-    P2OUT |= 0x10;
+    DebugTxEnqueue(*text++);
   }
-  //right
-  if (ping_num == 2)
+}
+
+void DebugTxUnsigned(uint32_t value)
+{
+  char digits[10];
+  uint8_t n = 0;
+  
+  do
   {
-    P2OUT |= 0x02;
+    digits[n++] = '0' + (value % 10);
+    value /= 10;
   }
-  for (i = 1000; i != 0; i--) {} ;   // Empty S-Ware delay loop
-  if (ping_num == 1)
+  while (value != 0);
+  
+  while (n > 0)
   {
-    P2OUT &= ~0x01;                          // Set Pin Low P2.0
+    DebugTxEnqueue(digits[--n]);
   }
-  if (ping_num == 0)
+}
+
+void ProfileDumpStep(void)
+//------------------------------------------------------------------------
+// Func:  Print the next line of a requested dump once the debug queue
+//        has room for it, so a dump never blocks or overflows
+//        "name n <count> min <cycles> max <cycles> avg <cycles>"
+//------------------------------------------------------------------------
+{
+  ProfileStats stats;
+  uint8_t probe;
+  
+  if (profileDumpNext == PROFILE_IDLE || DebugTxFree() < PROFILE_LINE_MAX)
   {
-    P2OUT &= ~0x10;
+    return;
   }
-  if (ping_num == 2)
+  
+  if (profileDumpNext == 0)
   {
-    P2OUT &= ~0x02;
+    DebugTxString("profile overhead ");
+    DebugTxUnsigned(profileOverhead);
+    DebugTxString("\r\n");
+    profileDumpNext = 1;
+    return;
   }
-  for (i = MAX_TICKS; i != 0; i--) {} ;   // Empty S-Ware delay loop
   
-  //have an emtpy loop to let right/left pings disapate
-  if (ping_num != 3)
+  probe = profileDumpNext - 1;
+  HalDisableIrq();
+  stats = profileStats[probe];          // ISRs may be adding to it
+  HalEnableIrq();
+  
+  DebugTxString(profileNames[probe]);
+  DebugTxString(" n ");
+  DebugTxUnsigned(stats.count);
+  if (stats.count != 0)
+  {
+    DebugTxString(" min ");
+    DebugTxUnsigned(stats.min);
+    DebugTxString(" max ");
+    DebugTxUnsigned(stats.max);
+    DebugTxString(" avg ");
+    DebugTxUnsigned(stats.total / stats.count);
+  }
+  DebugTxString("\r\n");
+  
+  profileDumpNext = (probe + 1 < PROFILE_PROBES) ? probe + 2 : PROFILE_IDLE;
+}
+#endif
+
+void TelemetryByte(uint8_t data)
+{
+  DebugTxEnqueue(data);
+  telemetrySumA += data;
+  telemetrySumB += telemetrySumA;
+}
+
+void TelemetryWord(uint16_t data)
+{
+  TelemetryByte((uint8_t)data);
+  TelemetryByte((uint8_t)(data >> 8));
+}
+
+void TelemetryTask(void)
+//------------------------------------------------------------------------
+// Func:  Send one telemetry frame of the robot's state. Runs after
+//        MotorTask, on its own channel, and only when the whole frame
+//        fits the queue, so it can't hold up a motor command.
+//        seq u8, tick u16, width us u16 x3, pinger u16 x3, state u8,
+//        right motor u8, left motor u8, stops u8, dodges u8, turns u8,
+//        battery mV u16
+//------------------------------------------------------------------------
+{
+  uint8_t n;
+  
+  if (DebugTxFree() < TELEMETRY_FRAME)
   {
-    CalculateDist(ping_num);
+    telemetrySkipCount++;
+    telemetrySeq++;
+    return;
   }
+  
+  DebugTxEnqueue(TELEMETRY_SYNC);
+  telemetrySumA = 0;
+  telemetrySumB = 0;
+  TelemetryByte(TELEMETRY_PAYLOAD);
+  TelemetryByte(telemetrySeq++);
+  TelemetryWord(tickCount);
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    TelemetryWord(EchoWidthUs(n));
+  }
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    TelemetryWord(pinger[n]);
+  }
+  TelemetryByte(CurrentState);
+  TelemetryByte(MotorCommitted(0));
+  TelemetryByte(MotorCommitted(1));
+  TelemetryByte(stopCondition);
+  TelemetryByte(dodgeCondition);
+  TelemetryByte(TurnCounter);
+  TelemetryWord(batteryMv);
+  DebugTxEnqueue(telemetrySumA);
+  DebugTxEnqueue(telemetrySumB);
+}
+
+void ButtonPressed(void)
+{
+  PROFILE_DUMP();
 }
 
-void HallwayLogic(uint8_t StateMachine)
+void DebugTask(void)
 //------------------------------------------------------------------------
-// Func:  Run the state machine for the robot
-// Args:  uint8_t StateMachine 
-//                - 0 (NOP STATE): NOP Mode
-//                - 1 (STRAIGHT MODE): This is the default mode of operation
-//                - 2 (TURN MODE): Enter turning mode
-//                - 3 (STOP MODE): Stop the robot
-//                - 4 
-// Retn:  None
+// Func:  Feed the debug channel
 //------------------------------------------------------------------------
 {
-  uint8_t MotorOneReturn = 0;
-  uint8_t MotorTwoReturn = 0;
-  CurrentState = 0;
+#ifdef PROFILE
+  ProfileDumpStep();
+#endif
+}
+
+void AdcPush(uint8_t channel, uint16_t raw)
+{
+  adcRaw[channel] = raw;
+  adcReady |= 1 << channel;
+}
 
-  if(StateMachine == 1)
+void AdcTask(void)
+//------------------------------------------------------------------------
+// Func:  Fold in the last ADC10 reading and start the next conversion:
+//        the battery every period, the temperature every TEMP_PERIODS
+//        in its place as the air changes slowly. Only one conversion
+//        is ever in flight, so adcReady can't change under us.
+//------------------------------------------------------------------------
+{
+  if (adcReady & (1 << ADC_TEMP))
   {
-    MotorController(0, 48);
-    MotorController(1, 52);
-    P1OUT |= 0x01;                      // Start of TX => toggle LEDs
-    P1OUT &= ~0x02;                      // Start of TX => toggle LEDs
+    TemperatureUpdate(adcRaw[ADC_TEMP]);
   }
-  else if(StateMachine == 2)
+  if (adcReady & (1 << ADC_BATTERY))
   {
-    TurnCounter++;
-    uint8_t pinger_sel = 0;
-    
-    MotorController(0, 20);
-    MotorController(1, 58);
-    P1OUT |= 0x02;                      // Start of TX => toggle LEDs
-    P1OUT &= ~0x01;                      // Start of TX => toggle LEDs
-    for (i = MAX_TICKS*6.5; i != 0; i--) {} ;   // Empty S-Ware delay loop
-    
-    //MotorController(0, 32);
-    //MotorController(1, 32);
-    
-    for (i = MAX_TICKS*4; i != 0; i--) {
-    } ;   // Empty S-Ware delay loop;
+    BatteryUpdate(adcRaw[ADC_BATTERY]);
   }
-  else if(StateMachine == 3)
-  {
-    MotorController(0, 64);
-    MotorController(1, 64);
-    P1OUT |= 0x03;                      // Start of TX => toggle LEDs
-    
-    for (i = MAX_TICKS*4; i != 0; i--) {} ;   // Empty S-Ware delay loop
-    
-    MotorController(0, 90);
-    MotorController(1, 90);
-        
-    do 
-    {
-      StartPinger(0);
-      for (i = MAX_TICKS; i != 0; i--) {} ;   // Empty S-Ware delay loop
-    }
-    while(pinger[0] < 3800);
-    
-    stopCondition++;
-    
-    
-    
-  }
-  //dodge ALL the obstacles
-  else if (StateMachine == 4)
+  adcReady = 0;
+  
+  if (--adcTempWait == 0)
   {
-    //head right
-      MotorController(0, 70);
-      MotorController(1, 5);
-    
-    do 
-    {
-      StartPinger(0);
-      for (i = MAX_TICKS; i != 0; i--) {} ;   // Empty S-Ware delay loop
-      
-      StartPinger(1);
-      for (i = MAX_TICKS; i != 0; i--) {} ;   // Empty S-Ware delay loop
-    }
-    while(pinger[0] < 4000 && pinger[1] < 2000);
-    
-    dodgeCondition++;
+    adcTempWait = TEMP_PERIODS;
+    HalAdcStart(ADC_TEMP);
   }
   else
   {
-    P1OUT &= ~0x03;                      // Start of TX => toggle LEDs
+    HalAdcStart(ADC_BATTERY);
   }
 }
 
-
-
-void InitPorts (void)
+void RobotInit(void)
 //------------------------------------------------------------------------
-// Func:  Initialize the ports for I/O on TA1 Capture
+// Func:  Init the board & robot state, then take the first reading
 // Args:  None
 // Retn:  None
 //------------------------------------------------------------------------
 {
-  P1DIR |= 0x03;                      // Config P1.0 as Output (LED)
-  P2DIR &= ~0x0C;                     // P2.3 % 2.2 = Input
-  P2SEL |= 0x0C;                      // P2.3 & 2.2 = TA1 & TA0 = TA compare OUT1
-  P2DIR |= 0x13;
-  P2OUT |= 0x13;                      // Toggle P2.0 = toggle LED
-  P4DIR &= ~0x08;                     // P4.3 = Input
-  P4SEL |= 0x08;                      // P4.3 = TB0 = TB compare OUT1
-  P3SEL = 0x30;                       // P3.4,5 = USCI_A0 TXD/RXD
-}
-
-void SetupBasicFunc (void)
-{
-  TACTL   = TASSEL_2 | ID_0 | MC_2;          // SMCLK | Div by 1 | Contin Mode
-  TACCTL0 = CM0 | CM1 | CCIS0 | CAP | SCS | CCIE;  // Ris Edge | Falling Edge | inp = CCI1B | 
-                                             // Capture | Sync Cap | Enab IRQ
-  TACCTL1 = CM0 | CM1 | CCIS0 | CAP | SCS | CCIE;  // Ris Edge | Falling Edge | inp = CCI1B | 
-                                             // Capture | Sync Cap | Enab IRQ
-  TBCTL   = TASSEL_2 | ID_0 | MC_2;          // SMCLK | Div by 1 | Contin Mode
-  TBCCTL0 = CM0 | CM1 | CCIS0 | CAP | SCS | CCIE;  // Ris Edge | Falling Edge | inp = CCI1B | 
-                                             // Capture | Sync Cap | Enab IRQ
-  
-  // Config. UART Clock & Baud Rate 
-  BCSCTL1 = CALBC1_1MHZ;                // DCO = 1 MHz
-  DCOCTL  = CALDCO_1MHZ;                // DCO = 1 MHz
-  UCA0CTL1 |= UCSSEL_2;                 // UART use SMCLK
-
-  UCA0MCTL = UCBRS0;                    // Map 1MHz -> 9600 (Tbl 15-4)
-  UCA0BR0  = 104;                       // Map 1MHz -> 9600 (Tbl 15-4)
-  UCA0BR1  = 0;                         // Map 1MHz -> 9600 (Tbl 15-4)
-
-  UCA0CTL1 &= ~UCSWRST;                 // Enable USCI state mach
-
-  while ( !(IFG2 & UCA0TXIFG)) {};      // Confirm that Tx Buff is empty
-  UCA0TXBUF = 0x00;                     // Init robot to stopped state
-
-  pulse_count[0] = 0;                           // Init input pulse counter
-  dist[0] = 0;                                  //Init distuency
-  pinger[0] = 0;
-  pinger[1] = 0;
-  pinger[2] = 0;
-  cycles[0] = 0;
-  cycles[1] = 0;
-  cycles[2] = 0;
-  fallingEdge[0] = 0;
-  risingEdge[0] = 0;
-  for(i=0; i < 9; i++)
-  {
-    history[i] = 0;
-  }
-  i=0;
-  edge[0] = 0;
+  HalInit();                                 // Configure clocks, I/O pins
+  SetupBasicFunc();
+  HalLedOff(LED_RED);
   
-  stopCondition = 0;
+  //one temperature and one battery reading before the first ping
+  AdcTask();
+  DelayTicks(STARTUP_TICKS / 2);
+  AdcTask();
+  DelayTicks(STARTUP_TICKS - STARTUP_TICKS / 2);
+  AdcTask();
   
-  _BIS_SR(GIE);                          // IRQs enab
+  StartPinger(0);
 }
 
-void CorrectionLogic(void)
+void RobotStep(void)
 //------------------------------------------------------------------------
-// Func:  Init I/O ports & IRQs, enter LoPwr Mode
+// Func:  Run released tasks, then sleep until the scheduler releases
+//        the next one
 // Args:  None
 // Retn:  None
-// Design Note: pinger[1] = Left Pinger
 //------------------------------------------------------------------------
 {
-   //sweet spot
-  if (pinger[1] > 2200 && pinger[1] < 2700)
-  {
-	MotorController(0, 40);
-	MotorController(1, 40);
-  }
-  //to close to left
-  else if( pinger[1] < 2200 )
+  RunReadyTasks();
+  
+  //IRQs off so a release can't slip in between the check and the sleep
+  HalDisableIrq();
+  if (TasksReady())
   {
-	if(pinger[1] > 1500)
-	{
-	  MotorController(0, 45);  //right motor
-	  MotorController(1, 35);
-	  P1OUT &= ~0x03;
-	}// Start of TX => toggle LEDs
-	else if(pinger[1] > 1000)
-	{
-	  MotorController(0, 50);  //right motor
-	  MotorController(1, 30);
-	}
-	else if(pinger[1] > 500)
-	{
-	  MotorController(0, 55);  //right motor
-	  MotorController(1, 25);
-	}
-	else
-	{
-	  MotorController(0,60);
-	  MotorController(1,20);
-	}
+    HalEnableIrq();
   }
-  //to far right
-  else if ( pinger[1] > 2700 )
+  else
   {
-	if(pinger[1] > 4500)
-	{
-	  MotorController(0, 20);
-	  MotorController(1, 60);  
-	}
-	else if(pinger[1] > 4000)
-	{
-	  MotorController(0, 25);  //right motor
-	  MotorController(1, 55);
-	}
-	else if(pinger[1] > 3200)
-	{
-	  MotorController(0, 30);  //right motor
-	  MotorController(1, 50);
-	}
-	else
-	{
-	  MotorController(0,35);
-	  MotorController(1,45);
-	}                     // Start of TX => toggle LEDs
+    HalSleep();
   }
 }
 
-
+#ifndef HOST_BUILD
+#ifdef __IAR_SYSTEMS_ICC__
 void main(void)
+#else
+int main(void)                          // gcc's -Wmain wants int
+#endif
 //------------------------------------------------------------------------
-// Func:  Init I/O ports & IRQs, enter LoPwr Mode
+// Func:  Init I/O ports & IRQs, run released tasks, sleep in LPM between
 // Args:  None
 // Retn:  None
 //------------------------------------------------------------------------
-{ WDTCTL = WDTPW | WDTHOLD;                  //Stop Watchdog Timer
-   
-  InitPorts();                               //  Configure I/O Pins
-  SetupBasicFunc();
-  CurrentState = 0;
-  P1OUT &= ~0x01;
-  uint8_t pinger_sel = 1;
-  uint8_t j = 0;
-  waiting = 0;
-  
-  for (i = 5000; i != 0; i--) {} ;
-  
-  //while(pinger[0] == 0 && pinger[1] == 0 && pinger[2] == 0)
-  for (i = 50; i != 0; i--) {} ;
-  {
-    //P2OUT ^= 0x03;
-    StartPinger(j);
-    j++;
-    j=j%2;
-  }
-  
-  //while(1){};
+{
+  RobotInit();
   
   while(1)
   {
-    StartPinger(pinger_sel);
-    
-    if (pinger[0] < 1770 && pinger[0] != 0)
-    {
-      //force stop if we're to close
-      HallwayLogic(3);
-      j=0;
-      //while(j<5000){j++;};
-    }
-    /*
-    else if (pinger[1] > 6500)
-    {
-      HallwayLogic(2);
-    }
-    */
-    //dodge, dodge, dodge
-    else if (pinger[0] < 4000 && pinger[0] != 0)
-    {
-      HallwayLogic(4);
-    }
-    //the hallway sensor is reading high
-    
-    else
-    {
-     CorrectionLogic();
-    }
-    pinger_sel++;
-    pinger_sel = pinger_sel % 2;
-    //pinger_sel = 1;
+    RobotStep();
   }
-  
-  _BIS_SR(LPM1_bits + GIE);                  // Enter LPM w/ IRQs enab
 }
+#endif
@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------
+// motor.c - Motor link: Sabertooth packets, the UART TX queue,
+//           request coalescing, keep-alive and battery compensation.
+//------------------------------------------------------------------------
+#include "motor.h"
+#include "profile.h"
+
+// LINK TIMING //
+#define MOTOR_REFRESH_PERIODS 10      // Resend unchanged commands this often
+#define MOTOR_BOOT_TICKS 1500         // Sabertooth start-up before it can autobaud
+
+// SABERTOOTH PACKETIZED SERIAL (address, command, data, checksum) //
+#define SABER_ADDRESS 128             // DIP switches 4-6 on
+#define SABER_BAUDING 0xAA            // Sent once so the Sabertooth finds our baud
+#define SABER_MOTOR1 6                // Motor 1, 0 = full reverse, 64 = stop
+#define SABER_MOTOR2 7                // Motor 2, same scale
+#define SABER_TIMEOUT 14              // Stop if no packet for data * 100 ms
+#define SABER_TIMEOUT_100MS 5         // 5 keep-alive periods of silence
+#define SABER_PACKET 4
+
+// BATTERY (ADC_BATTERY readings, see hal.h) //
+#define BATTERY_NOMINAL_MV 12000      // Pack voltage the speeds were tuned at
+#define BATTERY_CUTOFF_MV 10000       // Sag beyond this is not made up for
+#define BATTERY_FILTER_SHIFT 2        // Smooth the readings over ~4 samples
+
+// UART TX QUEUE //
+#define TX_QUEUE_SIZE 16              // Must be a power of two
+#define TX_QUEUE_MASK (TX_QUEUE_SIZE - 1)
+
+volatile uint8_t txQueue[TX_QUEUE_SIZE];
+volatile uint8_t txHead;              // Next free slot, written by main
+volatile uint8_t txTail;              // Next byte to send, written by ISR
+volatile uint8_t txDepthMax;          // High-water mark of queued bytes
+volatile uint16_t txOverflowCount;    // Bytes dropped on a full queue
+
+// MOTOR OUTPUT VARIABLES //
+volatile uint8_t motorRequested[2];   // Latest speed asked for per channel
+volatile uint8_t motorPending;        // Bit per channel changed, not sent yet
+volatile uint8_t motorSent;           // A frame already went out this period
+uint8_t motorLinkUp;                  // Bauding byte sent, packets accepted
+uint8_t motorRefresh;                 // Periods until the keep-alive resend
+volatile uint16_t motorSuppressedCount; // Redundant commands not sent
+volatile uint32_t left_motor;
+volatile uint32_t right_motor;
+
+// BATTERY VARIABLES //
+uint8_t batteryPrimed;                // batteryMv holds a real reading
+uint16_t batteryMv;                   // Filtered motor pack voltage
+uint16_t motorGainQ8;                 // Speed step scale for battery sag
+
+void MotorInit(void)
+//------------------------------------------------------------------------
+// Func:  Empty the TX queue and forget every request; the motors stay
+//        stopped until MotorTask brings the link up
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  txHead = 0;
+  txTail = 0;
+  txDepthMax = 0;
+  txOverflowCount = 0;
+  
+  motorRequested[0] = 0;
+  motorRequested[1] = 0;
+  motorPending = 0;
+  motorSent = 0;
+  motorLinkUp = 0;                      // Motors stay stopped until MotorTask
+  motorRefresh = MOTOR_REFRESH_PERIODS;
+  motorSuppressedCount = 0;
+  batteryPrimed = 0;
+  motorGainQ8 = 1 << 8;
+}
+
+uint8_t UartTxDepth(void)
+{
+  return (uint8_t)(txHead - txTail) & TX_QUEUE_MASK;
+}
+
+uint8_t UartTxFree(void)
+{
+  return TX_QUEUE_MASK - UartTxDepth();
+}
+
+uint8_t UartTxEnqueue(uint8_t data)
+//------------------------------------------------------------------------
+// Func:  Queue a byte for the USCI_A0 TX IRQ to send
+// Args:  data = byte to send
+// Retn:  0 Successful Exit
+//        1 Queue full, byte dropped and counted in txOverflowCount
+//------------------------------------------------------------------------
+{
+  uint8_t next = (txHead + 1) & TX_QUEUE_MASK;
+  uint8_t depth;
+  
+  if (next == txTail)
+  {
+    txOverflowCount++;
+    return 1;
+  }
+  
+  txQueue[txHead] = data;
+  txHead = next;                        // Publish before enabling the IRQ
+  
+  depth = UartTxDepth();
+  if (depth > txDepthMax)
+  {
+    txDepthMax = depth;
+  }
+  
+  HalUartTxStart();                     // TX IRQ drains the queue
+  return 0;
+}
+
+uint8_t UartTxNext(uint8_t *data)
+//------------------------------------------------------------------------
+// Func:  Hand the TX IRQ the next queued byte
+// Args:  data = where to put the byte
+// Retn:  1 if a byte was dequeued, 0 if the queue is empty
+//------------------------------------------------------------------------
+{
+  if (txTail == txHead)
+  {
+    return 0;
+  }
+  
+  *data = txQueue[txTail];
+  txTail = (txTail + 1) & TX_QUEUE_MASK;
+  return 1;
+}
+
+uint8_t MotorCompensate (uint8_t MotorSpeed)
+//------------------------------------------------------------------------
+// Func:  Scale a speed's steps away from stop by motorGainQ8, so the
+//        motor gets the same voltage whatever the battery charge
+// Args:  uint8_t MotorSpeed (1 = Full Reverse, 64 = Stop, 127 = Full Forward)
+// Retn:  the speed to send, 1..127
+//------------------------------------------------------------------------
+{
+  int16_t steps = (int16_t)MotorSpeed - 64;
+  
+  steps = Clamp16(((int32_t)steps * motorGainQ8 + 128) >> 8, 63);
+  return (uint8_t)(64 + steps);
+}
+
+uint8_t SaberPacket (uint8_t *frame, uint8_t command, uint8_t data)
+//------------------------------------------------------------------------
+// Func:  Write one packetized serial packet into a frame buffer
+// Args:  frame = where the packet goes, command = SABER_xxx, data = 0..127
+// Retn:  bytes written
+//------------------------------------------------------------------------
+{
+  frame[0] = SABER_ADDRESS;
+  frame[1] = command;
+  frame[2] = data;
+  frame[3] = (SABER_ADDRESS + command + data) & 0x7F;
+  return SABER_PACKET;
+}
+
+uint8_t SaberSend (const uint8_t *frame, uint8_t length)
+//------------------------------------------------------------------------
+// Func:  Queue a whole frame for the UART or none of it, so a full
+//        queue can never leave half a packet on the line
+// Args:  frame = bytes to send, length = their count
+// Retn:  0 Successful Exit
+//        1 TX Queue Full (frame dropped and counted in txOverflowCount)
+//------------------------------------------------------------------------
+{
+  uint8_t n;
+  
+  if (UartTxFree() < length)
+  {
+    txOverflowCount++;
+    return 1;
+  }
+  for (n = 0; n < length; n++)
+  {
+    UartTxEnqueue(frame[n]);
+  }
+  return 0;
+}
+
+uint8_t MotorController (uint8_t MotorMask)
+//------------------------------------------------------------------------
+// Func:  Build one frame holding a packet per selected motor at its
+//        requested speed and queue it as a unit. The speeds are
+//        compensated for battery sag on the way out; right_motor and
+//        left_motor keep the speeds asked for.
+// Args:  uint8_t MotorMask (bit 0 = Motor 1, bit 1 = Motor 2)
+// Retn:  0 Successful Exit (or nothing to send)
+//        2 TX Queue Full (frame dropped)
+//------------------------------------------------------------------------
+{
+  uint8_t frame[2 * SABER_PACKET];
+  uint8_t length = 0;
+  PROFILE_START(PROFILE_MOTOR);
+  
+  if (MotorMask & 0x01)
+  {
+    length += SaberPacket(frame + length, SABER_MOTOR1,
+                          MotorCompensate(motorRequested[0]));
+  }
+  if (MotorMask & 0x02)
+  {
+    length += SaberPacket(frame + length, SABER_MOTOR2,
+                          MotorCompensate(motorRequested[1]));
+  }
+  if (length == 0)
+  {
+    return PROFILE_RESULT(PROFILE_MOTOR, 0);
+  }
+  if (SaberSend(frame, length))
+  {
+    return PROFILE_RESULT(PROFILE_MOTOR, 2);
+  }
+  
+  if (MotorMask & 0x01)
+  {
+    right_motor = motorRequested[0];
+  }
+  if (MotorMask & 0x02)
+  {
+    left_motor = motorRequested[1];
+  }
+  motorPending &= ~MotorMask;
+  return PROFILE_RESULT(PROFILE_MOTOR, 0);
+}
+
+void MotorLinkStart (void)
+//------------------------------------------------------------------------
+// Func:  Send the bauding byte and arm the Sabertooth's serial timeout,
+//        then let the commands requested so far go out
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint8_t frame[1 + SABER_PACKET];
+  
+  frame[0] = SABER_BAUDING;
+  SaberPacket(frame + 1, SABER_TIMEOUT, SABER_TIMEOUT_100MS);
+  if (SaberSend(frame, sizeof(frame)) == 0)
+  {
+    motorLinkUp = 1;
+  }
+}
+
+uint8_t MotorCommitted (uint8_t MotorSelect)
+{
+  if (MotorSelect == 0)
+  {
+    return (uint8_t)right_motor;
+  }
+  return (uint8_t)left_motor;
+}
+
+void MotorRequest (uint8_t MotorSelect, uint8_t MotorSpeed)
+//------------------------------------------------------------------------
+// Func:  Ask for a motor speed. Changes are collected and MotorFlush
+//        sends them together once the running task is done; only the
+//        first frame in a control period goes out at once, later
+//        changes are coalesced and sent by MotorTask. Requests matching
+//        the last sent speed are dropped.
+// Args:  uint8_t MotorSelect (0 = Motor 1, 1 = Motor 2)
+//        uint8_t MotorSpeed (1 = Full Reverse, 64 = Stop, 127 = Full Forward)
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  if (MotorSelect > 1)
+  {
+    return;
+  }
+  
+  motorRequested[MotorSelect] = MotorSpeed;
+  
+  if (MotorSpeed == MotorCommitted(MotorSelect))
+  {
+    motorSuppressedCount++;
+    motorPending &= ~(1 << MotorSelect);
+  }
+  else
+  {
+    motorPending |= 1 << MotorSelect;
+  }
+}
+
+void MotorFlush (void)
+//------------------------------------------------------------------------
+// Func:  Send the pending changes of both motors in one frame, if this
+//        control period has not had its frame yet; otherwise they wait
+//        for MotorTask at the period's end
+//------------------------------------------------------------------------
+{
+  if (motorLinkUp && motorPending != 0 && !motorSent &&
+      MotorController(motorPending) == 0)
+  {
+    motorSent = 1;
+  }
+}
+
+void MotorTask(void)
+//------------------------------------------------------------------------
+// Func:  End of control period: send coalesced changes and the
+//        periodic keep-alive in one frame. That frame is the next
+//        period's one, so MotorFlush only sends at once in a period
+//        that opened with nothing to send. Nothing goes out until the
+//        Sabertooth has booted.
+//------------------------------------------------------------------------
+{
+  if (!motorLinkUp)
+  {
+    if ((int16_t)(tickCount - MOTOR_BOOT_TICKS) < 0)
+    {
+      return;
+    }
+    MotorLinkStart();
+    motorRefresh = 1;                   // Send the current speeds now
+  }
+  
+  //a channel never requested has nothing to keep alive
+  if (--motorRefresh == 0)
+  {
+    motorRefresh = MOTOR_REFRESH_PERIODS;
+    if (motorRequested[0] != 0)
+    {
+      motorPending |= 0x01;
+    }
+    if (motorRequested[1] != 0)
+    {
+      motorPending |= 0x02;
+    }
+  }
+  
+  motorSent = 0;
+  if (motorPending != 0 && MotorController(motorPending) == 0)
+  {
+    motorSent = 1;
+  }
+}
+
+int16_t MotorSteps( uint8_t MotorSelect )
+{
+  uint8_t speed = MotorCommitted(MotorSelect);
+  
+  if (speed == 0)
+  {
+    return 0;                         // Never sent, still stopped
+  }
+  return 64 - (int16_t)speed;         // Forward steps, < 64 drives forward
+}
+
+void BatteryUpdate(uint16_t raw)
+//------------------------------------------------------------------------
+// Func:  Fold a battery reading into batteryMv and set motorGainQ8 to
+//        BATTERY_NOMINAL_MV / batteryMv, so a sagging pack is driven
+//        at a higher duty for the same motor voltage
+// Args:  raw = ADC10 reading of the battery divider
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint16_t mv = (uint16_t)(((uint32_t)raw * BATTERY_ADC_MV_Q4) >> 4);
+  uint16_t limited;
+  
+  if (!batteryPrimed)
+  {
+    batteryPrimed = 1;
+    batteryMv = mv;
+  }
+  else
+  {
+    batteryMv += (int16_t)(mv - batteryMv) >> BATTERY_FILTER_SHIFT;
+  }
+  
+  limited = batteryMv < BATTERY_CUTOFF_MV ? BATTERY_CUTOFF_MV : batteryMv;
+  motorGainQ8 = (uint16_t)(((uint32_t)BATTERY_NOMINAL_MV << 8) / limited);
+}
@@ -0,0 +1,24 @@
+//------------------------------------------------------------------------
+// motor.h - Sabertooth motor link: packetized serial on USCI_A0
+//           through an IRQ-driven TX queue, speed requests coalesced
+//           into one frame per control period, battery sag made up.
+//------------------------------------------------------------------------
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#include "robot.h"
+
+#define CONTROL_PERIOD_TICKS 10       // Motor command period
+
+extern uint16_t batteryMv;            // Filtered motor pack voltage
+extern uint8_t motorLinkUp;           // Sabertooth bauded, commands go out
+
+void MotorInit(void);
+void MotorRequest(uint8_t MotorSelect, uint8_t MotorSpeed);
+void MotorFlush(void);                // After each task, sends what it asked for
+void MotorTask(void);
+uint8_t MotorCommitted(uint8_t MotorSelect); // Last speed sent, 0 = none yet
+int16_t MotorSteps(uint8_t MotorSelect); // Forward steps of the last speed sent
+void BatteryUpdate(uint16_t raw);     // ADC_BATTERY reading
+
+#endif
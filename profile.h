@@ -0,0 +1,60 @@
+//------------------------------------------------------------------------
+// profile.h - Cycle counts of the hot paths. Build with -DPROFILE
+//             (make PROFILE=1, or add it to the IAR defines) to keep
+//             min/max/mean per probe in RAM; the records are dumped as
+//             text on the debug channel when the robot stops or the
+//             button is pressed. Without PROFILE every macro compiles
+//             to nothing.
+//
+//   void Foo(void)
+//   {
+//     uint8_t n;
+//     PROFILE_START(PROFILE_FOO);     // last line of the declarations
+//     ...
+//     PROFILE_STOP(PROFILE_FOO);      // before every return
+//   }
+//
+// Times from main-loop code include any ISR that ran in between.
+//------------------------------------------------------------------------
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "hal.h"
+
+#define PROFILE_TIMER_READ 0          // TimerReadPinger
+#define PROFILE_CALC_DIST 1           // CalculateDist, or its RANGE_FLOAT path
+#define PROFILE_HAMPEL 2              // HampelFilter (was VoteForPinger)
+#define PROFILE_TRACK 3               // TrackRange
+#define PROFILE_CORRECTION 4          // CorrectionLogic
+#define PROFILE_MOTOR 5               // MotorController
+#define PROFILE_ISR_TA0 6             // Front capture
+#define PROFILE_ISR_TA1 7             // Left capture, tick, TAR overflow
+#define PROFILE_ISR_TB0 8             // Right capture
+#define PROFILE_ISR_TB1 9             // Debug UART bits, TBR overflow
+#define PROFILE_ISR_UART 10           // Sabertooth UART TX
+#define PROFILE_ISR_ADC 11            // Battery and temperature readings
+#define PROFILE_ISR_PORT1 12          // P1.2 button
+#define PROFILE_PROBES 13
+
+#ifdef PROFILE
+
+void ProfileReset(void);
+void ProfileRecord(uint8_t probe, uint16_t cycles);
+void ProfileDumpRequest(void);
+
+#define PROFILE_START(probe) uint16_t profileStart = HalCycleTimer()
+#define PROFILE_STOP(probe) \
+  ProfileRecord((probe), HalCycleTimer() - profileStart)
+#define PROFILE_RESULT(probe, value) (PROFILE_STOP(probe), (value))
+#define PROFILE_DUMP() ProfileDumpRequest()
+
+#else
+
+#define PROFILE_START(probe)
+#define PROFILE_STOP(probe)
+#define PROFILE_RESULT(probe, value) (value)
+#define PROFILE_DUMP()
+
+#endif
+
+#endif
@@ -0,0 +1,511 @@
+//------------------------------------------------------------------------
+// ranging.c - Range filter: Hampel window and alpha-beta tracker
+//             per pinger, echo widths to mm with the air temperature.
+//------------------------------------------------------------------------
+#include "ranging.h"
+#include "capture.h"
+#include "motor.h"
+#include "state.h"
+#include "profile.h"
+
+// RANGE TRACKER (alpha-beta per pinger, range Q4 us, rate Q8 us/tick) //
+#define TRACK_ALPHA_Q8 64             // Share of the innovation taken as range
+#define TRACK_BETA_Q8 16              // Share of the innovation taken as rate
+#define TRACK_GATE_US 250             // Bigger innovations are outliers (~43 mm)
+#define TRACK_MAX_MISSES 2            // Outliers in a row before re-seeding
+#define TRACK_MAX_DT_TICKS 200        // Longer gaps re-seed the track
+#define TRACK_FWD_RATE_Q8 19          // Front closing rate per forward speed step
+#define TRACK_TURN_ACCEL_Q24 53       // Side rate change per tick per fwd*turn step
+
+// RANGE FILTER (Hampel on the raw echo widths ahead of the tracker) //
+#ifndef RANGE_WINDOW
+#define RANGE_WINDOW 5                // Echoes per pinger window: 3, 5 or 7
+#endif
+#define RANGE_HAMPEL_K_Q4 71          // Reject beyond 3 sigma = 3*1.4826*MAD
+#define RANGE_HAMPEL_MIN_US 120       // Threshold floor when MAD is ~0 (~20 mm)
+#if RANGE_WINDOW != 3 && RANGE_WINDOW != 5 && RANGE_WINDOW != 7
+#error "RANGE_WINDOW must be 3, 5 or 7"
+#endif
+
+// AIR TEMPERATURE (ADC_TEMP readings, see hal.h) //
+#define TEMP_FILTER_SHIFT 2           // Smooth the readings over ~4 samples
+#define TEMP_LIMIT_C 60               // Readings beyond +-this are clamped
+#define TEMP_DEFAULT_C 20             // Assumed until the first reading
+#define SOUND_MM_S_0C 331300L         // Speed of sound in air at 0 C
+#define SOUND_MM_S_PER_C 606          // and its rise per degree C
+
+volatile uint16_t pinger[3];          //Filtered range (mm), 0 = none yet
+volatile int16_t pingerRate[3];       //Tracked range rate (mm/tick, Q8)
+
+// RANGE FILTER VARIABLES //
+uint16_t rangeRing[3][RANGE_WINDOW];  // Echo widths in arrival order
+uint16_t rangeSorted[3][RANGE_WINDOW]; // The same widths kept sorted
+uint8_t rangeHead[3];                 // Oldest slot in rangeRing
+uint8_t rangeFilled;                  // Bit per pinger with a live window
+volatile uint16_t hampelCount[3];     // Echoes replaced by the median
+
+// RANGE TRACKER VARIABLES //
+int32_t trackRange[3];                // Q4 us
+int32_t trackRate[3];                 // Q8 us/tick, on top of MotionPrior
+uint16_t trackTick[3];                // tickCount of the last update
+uint8_t trackMisses[3];               // Outliers in a row
+uint8_t trackPrimed;                  // Bit per pinger with a live track
+volatile uint16_t trackOutlierCount[3]; // Echoes gated out per pinger
+
+// AIR TEMPERATURE VARIABLES //
+uint8_t airTempPrimed;                // airTempQ4 holds a real reading
+int16_t airTempQ4;                    // Filtered air temperature (C, Q4)
+uint16_t soundScale;                  // mm of range per us of echo (Q16)
+
+#ifdef RANGE_FLOAT
+// FLOAT PATH (the ranging path before fixed point, built only to time it
+// against this one; no Hampel, no tracker, pingerRate stays 0) //
+volatile float history[9];            // Last 3 echo widths per pinger (cycles)
+volatile float floatPinger[3];        // Voted echo width (cycles)
+
+float VoteForPinger( uint8_t ping_num )
+{
+  float diff1 = history[ping_num*3] - history[ping_num*3+1];
+  float diff2 = history[ping_num*3+1] - history[ping_num*3+2];
+  float diff3 = history[ping_num*3] - history[ping_num*3+2];
+  
+  if (diff1 < 0)
+  {
+    diff1 = diff1 * -1;
+  }
+  if (diff2 < 0)
+  {
+    diff2 = diff2 * -1;
+  }
+  if (diff3 < 0)
+  {
+    diff3 = diff3 * -1;
+  }
+  
+  if (diff1 < diff2 && diff1 < diff3)
+  {
+    return history[ping_num*3];
+  }
+  else if (diff2 < diff1 && diff2 < diff3)
+  {
+    return history[ping_num*3+1];
+  }
+  else if (diff3 < diff1 && diff3 < diff2)
+  {
+    return history[ping_num*3+2];
+  }
+  return floatPinger[ping_num];
+}
+#endif
+
+uint16_t AbsDiff( uint16_t a, uint16_t b )
+{
+  if (a > b)
+  {
+    return a - b;
+  }
+  return b - a;
+}
+
+uint16_t RangeWindowPush( uint8_t ping_num, uint16_t width )
+//------------------------------------------------------------------------
+// Func:  Put an echo width into the pinger's window. The ring slot of
+//        the oldest width is overwritten in place; in the sorted copy
+//        the oldest width is swapped for the new one and bubbled into
+//        order, which is usually a step or two as echoes change slowly.
+// Args:  ping_num = pinger, width = new echo width
+// Retn:  the window median
+//------------------------------------------------------------------------
+{
+  uint8_t bit = 1 << ping_num;
+  uint16_t *sorted = rangeSorted[ping_num];
+  uint16_t old;
+  uint16_t swap;
+  uint8_t j;
+  
+  if (!(rangeFilled & bit))
+  {
+    //first echo stands in for the whole window
+    rangeFilled |= bit;
+    rangeHead[ping_num] = 0;
+    for (j = 0; j < RANGE_WINDOW; j++)
+    {
+      rangeRing[ping_num][j] = width;
+      sorted[j] = width;
+    }
+    return width;
+  }
+  
+  old = rangeRing[ping_num][rangeHead[ping_num]];
+  rangeRing[ping_num][rangeHead[ping_num]] = width;
+  if (++rangeHead[ping_num] == RANGE_WINDOW)
+  {
+    rangeHead[ping_num] = 0;
+  }
+  
+  j = 0;
+  while (sorted[j] != old)
+  {
+    j++;
+  }
+  sorted[j] = width;
+  while (j > 0 && sorted[j - 1] > sorted[j])
+  {
+    swap = sorted[j - 1];
+    sorted[j - 1] = sorted[j];
+    sorted[j] = swap;
+    j--;
+  }
+  while (j + 1 < RANGE_WINDOW && sorted[j + 1] < sorted[j])
+  {
+    swap = sorted[j + 1];
+    sorted[j + 1] = sorted[j];
+    sorted[j] = swap;
+    j++;
+  }
+  
+  return sorted[RANGE_WINDOW / 2];
+}
+
+uint16_t RangeWindowMad( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Median absolute deviation of the pinger's window. Walking out
+//        from the median of the sorted window yields the deviations in
+//        increasing order, so no second sort is needed.
+// Args:  ping_num = pinger
+// Retn:  the MAD in us
+//------------------------------------------------------------------------
+{
+  const uint16_t *sorted = rangeSorted[ping_num];
+  uint16_t median = sorted[RANGE_WINDOW / 2];
+  uint8_t lo = RANGE_WINDOW / 2;
+  uint8_t hi = RANGE_WINDOW / 2;
+  uint16_t below;
+  uint16_t above;
+  uint16_t dev = 0;
+  uint8_t k;
+  
+  //the median itself is deviation 0, take RANGE_WINDOW/2 more
+  for (k = 0; k < RANGE_WINDOW / 2; k++)
+  {
+    below = (lo > 0) ? median - sorted[lo - 1] : 0xFFFF;
+    above = (hi + 1 < RANGE_WINDOW) ? sorted[hi + 1] - median : 0xFFFF;
+    if (below <= above)
+    {
+      dev = below;
+      lo--;
+    }
+    else
+    {
+      dev = above;
+      hi++;
+    }
+  }
+  return dev;
+}
+
+uint16_t HampelFilter( uint8_t ping_num, uint16_t width )
+//------------------------------------------------------------------------
+// Func:  Pass an echo width through unless it sits further from the
+//        window median than RANGE_HAMPEL_K_Q4 scaled MADs, in which case
+//        the median is used instead. Good echoes are not delayed.
+// Args:  ping_num = pinger, width = new echo width
+// Retn:  the width to track
+//------------------------------------------------------------------------
+{
+  uint16_t median;
+  uint32_t limit;
+  PROFILE_START(PROFILE_HAMPEL);
+  
+  median = RangeWindowPush(ping_num, width);
+  limit = ((uint32_t)RangeWindowMad(ping_num) * RANGE_HAMPEL_K_Q4) >> 4;
+  if (limit < RANGE_HAMPEL_MIN_US)
+  {
+    limit = RANGE_HAMPEL_MIN_US;
+  }
+  if (AbsDiff(width, median) > limit)
+  {
+    hampelCount[ping_num]++;
+    return PROFILE_RESULT(PROFILE_HAMPEL, median);
+  }
+  return PROFILE_RESULT(PROFILE_HAMPEL, width);
+}
+
+int32_t MotionPrior( uint8_t ping_num, uint16_t dt )
+//------------------------------------------------------------------------
+// Func:  Range rate the pinger should see from the robot's own motion,
+//        taken from the last motor commands. The front echo closes at
+//        the forward speed. A turn swings the heading, which changes
+//        how fast the side echoes close, so for the sides the turn is
+//        folded into trackRate instead of being returned.
+// Args:  ping_num = pinger, dt = ticks since its last update
+// Retn:  rate to add to trackRate (Q8 us/tick)
+//------------------------------------------------------------------------
+{
+  int16_t right = MotorSteps(0);
+  int16_t left = MotorSteps(1);
+  int16_t fwd = (right + left) / 2;
+  int16_t turn = right - left;        // > 0 turns left
+  int32_t accel;
+  
+  if (ping_num == 0)
+  {
+    return -(int32_t)fwd * TRACK_FWD_RATE_Q8;
+  }
+  
+  accel = ((int32_t)fwd * turn * TRACK_TURN_ACCEL_Q24 * dt) >> 16;
+  if (ping_num == 1)
+  {
+    trackRate[1] -= accel;            // Turning left closes on the left wall
+  }
+  else
+  {
+    trackRate[2] += accel;
+  }
+  return 0;
+}
+
+uint16_t TrackRange( uint8_t ping_num, uint16_t width, uint16_t seed )
+//------------------------------------------------------------------------
+// Func:  Alpha-beta tracker on one pinger's echo width. The prediction
+//        uses the tracked rate plus MotionPrior; an echo too far from the
+//        prediction is gated out and the track coasts. Several outliers
+//        in a row mean the scene really changed, so the track restarts
+//        from the window median.
+// Args:  ping_num = pinger, width = new echo width, seed = window median
+// Retn:  the tracked width for pinger[]
+//------------------------------------------------------------------------
+{
+  uint8_t bit = 1 << ping_num;
+  uint16_t now = tickCount;
+  uint16_t dt = now - trackTick[ping_num];
+  int32_t rate;
+  int32_t predicted;
+  int32_t innov;
+  PROFILE_START(PROFILE_TRACK);
+  
+  trackTick[ping_num] = now;
+  
+  if (!(trackPrimed & bit) || dt > TRACK_MAX_DT_TICKS)
+  {
+    trackPrimed |= bit;
+    trackMisses[ping_num] = 0;
+    trackRange[ping_num] = (int32_t)width << 4;
+    trackRate[ping_num] = 0;
+    pingerRate[ping_num] = 0;
+    return PROFILE_RESULT(PROFILE_TRACK, width);
+  }
+  if (dt == 0)
+  {
+    dt = 1;
+  }
+  
+  rate = MotionPrior(ping_num, dt);   // Sides update trackRate here
+  rate += trackRate[ping_num];
+  predicted = trackRange[ping_num] + ((rate * dt) >> 4);
+  innov = ((int32_t)width << 4) - predicted;
+  
+  if (innov > ((int32_t)TRACK_GATE_US << 4) ||
+      innov < -((int32_t)TRACK_GATE_US << 4))
+  {
+    trackOutlierCount[ping_num]++;
+    trackRange[ping_num] = predicted;
+    if (++trackMisses[ping_num] > TRACK_MAX_MISSES)
+    {
+      trackMisses[ping_num] = 0;
+      trackRange[ping_num] = (int32_t)seed << 4;
+      trackRate[ping_num] = 0;
+    }
+  }
+  else
+  {
+    trackMisses[ping_num] = 0;
+    trackRange[ping_num] = predicted + ((innov * TRACK_ALPHA_Q8) >> 8);
+    trackRate[ping_num] += ((innov * TRACK_BETA_Q8) / dt) >> 4;
+  }
+  
+  pingerRate[ping_num] = (int16_t)(((int32_t)Clamp16(rate, 0x7FFF)
+                                     * soundScale) >> 16);
+  
+  //pinger[] == 0 means no reading, and widths are 16-bit
+  if (trackRange[ping_num] < (1 << 4))
+  {
+    trackRange[ping_num] = 1 << 4;
+  }
+  if (trackRange[ping_num] > (0xFFFFL << 4))
+  {
+    trackRange[ping_num] = 0xFFFFL << 4;
+  }
+  return PROFILE_RESULT(PROFILE_TRACK,
+                        (uint16_t)((trackRange[ping_num] + 8) >> 4));
+}
+
+uint16_t EchoWidthUs( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  A pinger's last echo width in us, whatever the clock. us keep
+//        16-bit widths good for 11 m and well below the pingers' own
+//        jitter, so the filters are tuned once for every CLOCK_MHZ.
+// Args:  ping_num = pinger
+// Retn:  the width, clipped to 0xFFFF (out of range anyway)
+//------------------------------------------------------------------------
+{
+  uint32_t width = cycles[ping_num] >> ECHO_US_SHIFT;
+  
+  return width > 0xFFFF ? 0xFFFF : (uint16_t)width;
+}
+
+void SoundScaleUpdate(void)
+//------------------------------------------------------------------------
+// Func:  Derive soundScale from airTempQ4. Halving the round trip and
+//        the Q16 scale fold into one shift: mm/s * 2^15 / 10^6, done
+//        as << 12 and / 125000 to stay inside 32 bits.
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint32_t speed = SOUND_MM_S_0C +
+                   (((int32_t)SOUND_MM_S_PER_C * airTempQ4) >> 4);
+  
+  soundScale = (uint16_t)((speed << 12) / 125000L);
+}
+
+uint16_t WidthToMm( uint16_t width )
+//------------------------------------------------------------------------
+// Func:  Turn an echo width into a range with the speed of sound at the
+//        measured air temperature. One 16x16 multiply, no float math
+//        (the F2274 has no FPU).
+// Args:  width = echo width in us
+// Retn:  range in mm, at least 1 for any echo
+//------------------------------------------------------------------------
+{
+  uint16_t mm = (uint16_t)(((uint32_t)width * soundScale + 0x8000) >> 16);
+  
+  return mm != 0 ? mm : 1;            // pinger[] == 0 means no reading
+}
+
+void TemperatureUpdate(uint16_t raw)
+//------------------------------------------------------------------------
+// Func:  Fold a temperature reading into airTempQ4 and update
+//        soundScale. The sensor is noisy, so readings are smoothed.
+// Args:  raw = ADC10 reading of the temperature sensor
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  int16_t temp = Clamp16((((int32_t)raw - TEMP_ADC_OFFSET) *
+                          TEMP_ADC_SCALE_Q10) >> 6, TEMP_LIMIT_C << 4);
+  
+  if (!airTempPrimed)
+  {
+    airTempPrimed = 1;
+    airTempQ4 = temp;
+  }
+  else
+  {
+    airTempQ4 += (temp - airTempQ4) >> TEMP_FILTER_SHIFT;
+  }
+  SoundScaleUpdate();
+}
+
+void CalculateDist( uint8_t ping_num )
+//------------------------------------------------------------------------
+// Func:  Filter a new echo width into pinger[]. The filter and tracker
+//        work on echo widths in us; only their result is scaled to mm,
+//        so every threshold and the controller see true distance
+//        whatever the air temperature.
+// Args:  ping_num = the pinger with a new echo
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint16_t width;
+  PROFILE_START(PROFILE_CALC_DIST);
+  
+  if (IsCrosstalk(ping_num))
+  {
+    crosstalkCount[ping_num]++;
+    PROFILE_STOP(PROFILE_CALC_DIST);
+    return;
+  }
+  
+#ifdef RANGE_FLOAT
+  (void)width;
+  history[ping_num*3] = history[ping_num*3+1];
+  history[ping_num*3+1] = history[ping_num*3+2];
+  history[ping_num*3+2] = cycles[ping_num];
+  floatPinger[ping_num] = VoteForPinger(ping_num);
+  pinger[ping_num] = (uint16_t)(floatPinger[ping_num] *
+                                (331.3f + 0.606f * airTempQ4 / 16.0f) /
+                                (2000.0f * CLOCK_MHZ) + 0.5f);
+#else
+  width = EchoWidthUs(ping_num);
+  width = HampelFilter(ping_num, width);
+  width = TrackRange(ping_num, width, rangeSorted[ping_num][RANGE_WINDOW / 2]);
+  pinger[ping_num] = WidthToMm(width);
+#endif
+  
+  if (ping_num == 1)
+  {
+    leftSampleReady = 1;
+  }
+  else if (ping_num == 2)
+  {
+    rightSampleReady = 1;
+  }
+  PROFILE_STOP(PROFILE_CALC_DIST);
+}
+
+void StartPinger( uint8_t ping_num )
+{
+  TriggerPinger(ping_num);
+  
+  //sleep until the echo ends or times out
+  ProcessCaptures();
+  while ((waiting & (1 << ping_num)) ||
+         ((echoReady & (1 << ping_num)) && !EchoSettled(ping_num)))
+  {
+    DelayTicks(1);
+    ProcessCaptures();
+  }
+  
+  if (TakeEcho(ping_num))
+  {
+    CalculateDist(ping_num);
+  }
+}
+
+void DistanceTask(void)
+//------------------------------------------------------------------------
+// Func:  Turn queued captures into echo widths, then process every
+//        completed echo. Fresh echoes are left for the next tick until
+//        EchoSettled.
+//------------------------------------------------------------------------
+{
+  uint8_t n;
+  
+  ProcessCaptures();
+  
+  for (n = 0; n < NUM_PINGERS; n++)
+  {
+    if ((echoReady & (1 << n)) && EchoSettled(n) && TakeEcho(n))
+    {
+      CalculateDist(n);
+    }
+  }
+}
+
+void RangingInit(void)
+//------------------------------------------------------------------------
+// Func:  Drop every range, filter window and track, and assume
+//        TEMP_DEFAULT_C until the first temperature reading
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  pinger[0] = 0;
+  pinger[1] = 0;
+  pinger[2] = 0;
+  rangeFilled = 0;
+  trackPrimed = 0;
+  airTempPrimed = 0;
+  airTempQ4 = TEMP_DEFAULT_C << 4;
+  SoundScaleUpdate();
+}
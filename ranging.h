@@ -0,0 +1,22 @@
+//------------------------------------------------------------------------
+// ranging.h - Echo widths to ranges: a Hampel filter and an
+//             alpha-beta tracker on the widths in us, then mm at the
+//             speed of sound for the measured air temperature.
+//------------------------------------------------------------------------
+#ifndef RANGING_H
+#define RANGING_H
+
+#include "robot.h"
+
+extern volatile uint16_t pinger[3];   // Filtered range (mm), 0 = none yet
+extern volatile int16_t pingerRate[3]; // Tracked range rate (mm/tick, Q8)
+
+void RangingInit(void);
+uint16_t EchoWidthUs(uint8_t ping_num);
+uint16_t WidthToMm(uint16_t width);   // Echo width (us) to range (mm)
+void TemperatureUpdate(uint16_t raw); // ADC_TEMP reading
+void CalculateDist(uint8_t ping_num);
+void StartPinger(uint8_t ping_num);   // One blocking reading, at start-up only
+void DistanceTask(void);
+
+#endif
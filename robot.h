@@ -0,0 +1,36 @@
+//------------------------------------------------------------------------
+// robot.h - Shared by the logic modules: the pinger count and the
+//           cooperative scheduler in main.c (1 tick = 1 ms). Modules
+//           talk to the board only through hal.h.
+//------------------------------------------------------------------------
+#ifndef ROBOT_H
+#define ROBOT_H
+
+#include "stdint.h"
+#include "hal.h"
+
+#define NUM_PINGERS 3                 // 0 = front, 1 = left, 2 = right
+
+//the scheduler's tasks, run in this order when released in the same
+//tick: id, body, period in ticks (0 = released by IRQs only), ticks to
+//the first release. main.c builds tasks[] from this list, so the ids
+//always index it.
+#define TASK_TABLE(TASK) \
+  TASK(DISTANCE_TASK,  DistanceTask,  0,                      0) \
+  TASK(PING_TASK,      PingTask,      1,                      1) \
+  TASK(STEERING_TASK,  SteeringTask,  STATE_PERIOD_TICKS,     1) \
+  TASK(MOTOR_TASK,     MotorTask,     CONTROL_PERIOD_TICKS,   1) \
+  TASK(TELEMETRY_TASK, TelemetryTask, TELEMETRY_PERIOD_TICKS, 1) \
+  TASK(DEBUG_TASK,     DebugTask,     1,                      1) \
+  TASK(ADC_TASK,       AdcTask,       ADC_PERIOD_TICKS,       ADC_PERIOD_TICKS)
+
+#define TASK_ID(id, run, period, first) id,
+enum { TASK_TABLE(TASK_ID) NUM_TASKS };
+
+extern volatile uint16_t tickCount;
+
+void SchedulerRelease(uint8_t task);  // Mark a task ready, safe from IRQs
+void DelayTicks(uint16_t ticks);      // Sleep, motor output keeps flowing
+int16_t Clamp16(int32_t value, int16_t limit);
+
+#endif
@@ -0,0 +1,493 @@
+//------------------------------------------------------------------------
+// state.c - Hallway state machine: stop, back up, dodge and turn
+//           on the front range, fixed-point PID on the left wall.
+//------------------------------------------------------------------------
+#include "state.h"
+#include "ranging.h"
+#include "capture.h"
+#include "motor.h"
+#ifdef STEER_LUT_FILE
+#include STEER_LUT_FILE                // host gain sweep, see host/Makefile
+#else
+#include "steer_lut.h"
+#endif
+#include "profile.h"
+
+// STATE TIMING (ticks) //
+#define TURN_TICKS 180                // Spin time for a turn
+#define TURN_SETTLE_TICKS 110         // Coast time after a turn
+#define STOP_HOLD_TICKS 110           // Time held stopped before backing up
+#define BACKUP_MAX_TICKS 2000         // Longest reverse, ~650 mm at speed 90
+#define DODGE_TURN_MAX_TICKS 650      // Spin one way before trying the other
+#define DODGE_CROSS_TICKS 2000        // Longest crossing to the free side
+#define DODGE_PASS_TICKS 1500         // Pass time if nothing shows beside us
+#define DODGE_PASS_MAX_TICKS 4000     // Longest pass beside an obstacle
+
+// RANGE THRESHOLDS //
+#define STOP_RANGE_MM 304             // Front closer than this stops
+#define BACKUP_CLEAR_MM 652           // Front clear enough to stop reversing
+#define BACKUP_SIDE_MM 200            // Side closer than this ends a reverse
+#define DODGE_RANGE_MM 687            // Front closer than this dodges
+#define DODGE_CLEAR_MM 150            // Front past the nearest spin range by this
+#define DODGE_LANE_MM 250             // Far wall range held while passing
+#define DODGE_WALL_MM 400             // Front on the far wall ends the cross
+#define DODGE_FLANK_MM 200            // Side shortfall that means an obstacle
+#define TURN_OPEN_MM 1116             // Left further than this is an opening
+
+// DODGE SPIN (motor speed steps) //
+#define DODGE_SLOW 64                 // Inside wheel, stopped
+#define DODGE_FAST 30                 // Outside wheel, cruise
+
+// STEERING VARIABLES //
+volatile uint8_t leftSampleReady;     // New left reading for the PID
+volatile uint8_t rightSampleReady;    // New right reading for the PID
+uint16_t wallSampleTick;              // tickCount of the last wall reading
+int16_t steerPrevError;
+int32_t steerIntegral;
+uint8_t steerPrimed;                  // steerPrevError/wallSampleTick valid
+int32_t steerTarget;                  // Range held now (mm << STEER_SLEW_SHIFT),
+                                      // 0 = start from the next reading
+
+// STATE MACHINE VARIBLES //
+volatile uint8_t CurrentState;
+volatile uint8_t TurnCounter;
+uint16_t stateTick;                   // tickCount when CurrentState was entered
+
+volatile uint8_t stopCondition;
+volatile uint8_t dodgeCondition;
+uint8_t dodgeRight;                   // Passing on the right of the obstacle
+int16_t dodgeTurn;                    // Net ticks spun, + = right
+uint8_t dodgeReversed;                // Spin already turned the other way
+uint16_t dodgeNear;                   // Nearest front range while spinning
+uint8_t dodgeFlank;                   // Obstacle seen beside us while passing
+uint16_t dodgeWidth;                  // Side ranges added up when the dodge began
+
+void StateInit(void)
+//------------------------------------------------------------------------
+// Func:  Start in the NOP state with no wall samples
+// Args:  None
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  CurrentState = STATE_NOP;
+  stopCondition = 0;
+  leftSampleReady = 0;
+  rightSampleReady = 0;
+  steerPrimed = 0;
+}
+
+void DodgeSpin(uint8_t right)
+//------------------------------------------------------------------------
+// Func:  Pivot on the inside wheel, forward on the outside one
+// Args:  right = 1 to turn right, 0 for left
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  if (right)
+  {
+    MotorRequest(0, DODGE_SLOW);
+    MotorRequest(1, DODGE_FAST);
+  }
+  else
+  {
+    MotorRequest(0, DODGE_FAST);
+    MotorRequest(1, DODGE_SLOW);
+  }
+}
+
+int8_t DodgeSpun(void)
+//------------------------------------------------------------------------
+// Func:  Tell which way the motors are spinning this tick. Counting from
+//        what the Sabertooth actually has keeps the spin timing honest
+//        while a command is still waiting to go out.
+// Args:  None
+// Retn:  1 = spinning right, -1 = left, 0 = not spinning
+//------------------------------------------------------------------------
+{
+  if (MotorCommitted(0) == DODGE_SLOW && MotorCommitted(1) == DODGE_FAST)
+  {
+    return 1;
+  }
+  if (MotorCommitted(0) == DODGE_FAST && MotorCommitted(1) == DODGE_SLOW)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+void HallwayLogic(uint8_t StateMachine)
+//------------------------------------------------------------------------
+// Func:  Enter a state of the robot's state machine: set the motors and
+//        LEDs for it and note the tick. Nothing here waits, SteeringTask
+//        decides when to leave the state.
+// Args:  uint8_t StateMachine 
+//                - 0 (NOP STATE): NOP Mode
+//                - 1 (STRAIGHT MODE): This is the default mode of operation
+//                - 2 (TURN MODE): Enter turning mode
+//                - 3 (STOP MODE): Stop the robot
+//                - 4 (DODGE MODE): Spin toward the side with more room
+//                - 5 (BACKUP MODE): Reverse away from the obstacle
+//                - 6 (SETTLE MODE): Coast after a turn
+//                - 7 (CROSS MODE): Drive across to the free side
+//                - 8 (SQUARE MODE): Spin back square to the hallway
+//                - 9 (PASS MODE): Follow the far wall past the obstacle
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  CurrentState = StateMachine;
+  stateTick = tickCount;
+
+  if(StateMachine == STATE_FOLLOW)
+  {
+    MotorRequest(0, STEER_BASE_SPEED);
+    MotorRequest(1, STEER_BASE_SPEED);
+    steerPrimed = 0;                    // Old samples say nothing now
+    steerTarget = 0;
+    HalLedOn(LED_RED);                  // Start of TX => toggle LEDs
+    HalLedOff(LED_GREEN);               // Start of TX => toggle LEDs
+  }
+  else if(StateMachine == STATE_TURN)
+  {
+    TurnCounter++;
+    MotorRequest(0, 20);
+    MotorRequest(1, 58);
+    HalLedOn(LED_GREEN);                // Start of TX => toggle LEDs
+    HalLedOff(LED_RED);                 // Start of TX => toggle LEDs
+  }
+  else if(StateMachine == STATE_TURN_SETTLE)
+  {
+    //MotorController(0, 32);
+    //MotorController(1, 32);
+  }
+  else if(StateMachine == STATE_STOP)
+  {
+    MotorRequest(0, 64);
+    MotorRequest(1, 64);
+    HalLedOn(LED_RED | LED_GREEN);      // Start of TX => toggle LEDs
+    PROFILE_DUMP();
+  }
+  else if(StateMachine == STATE_BACKUP)
+  {
+    MotorRequest(0, 90);
+    MotorRequest(1, 90);
+  }
+  //dodge ALL the obstacles
+  else if (StateMachine == STATE_DODGE)
+  {
+    //head for the side with more room, 0 = no reading = no room known
+    dodgeRight = (pinger[2] > pinger[1]);
+    dodgeWidth = pinger[1] + pinger[2];
+    dodgeTurn = 0;
+    dodgeReversed = 0;
+    dodgeNear = pinger[0];
+    DodgeSpin(dodgeRight);
+  }
+  else if (StateMachine == STATE_DODGE_CROSS)
+  {
+    MotorRequest(0, STEER_BASE_SPEED);
+    MotorRequest(1, STEER_BASE_SPEED);
+  }
+  else if (StateMachine == STATE_DODGE_SQUARE)
+  {
+    DodgeSpin(dodgeTurn < 0);
+  }
+  else if (StateMachine == STATE_DODGE_PASS)
+  {
+    dodgeFlank = 0;
+    steerPrimed = 0;                    // Different wall, different error
+    steerTarget = 0;
+  }
+  else
+  {
+    HalLedOff(LED_RED | LED_GREEN);     // Start of TX => toggle LEDs
+  }
+}
+
+uint8_t SteerBin( int32_t scaled, uint8_t bins )
+//------------------------------------------------------------------------
+// Func:  Turn a signed, already rounded and scaled value into a table
+//        index with zero in the middle, clamping at both ends
+// Args:  scaled = value in bin units, bins = table size
+// Retn:  0..bins-1
+//------------------------------------------------------------------------
+{
+  scaled += bins / 2;
+  if (scaled < 0)
+  {
+    return 0;
+  }
+  if (scaled >= bins)
+  {
+    return bins - 1;
+  }
+  return (uint8_t)scaled;
+}
+
+void CorrectionLogic(uint8_t ping_num, int16_t setpoint)
+//------------------------------------------------------------------------
+// Func:  Fixed-point PID on one wall distance. Called once per new
+//        reading of that wall, with the derivative and integral scaled
+//        by the real time between readings. P and D come from steerLut, indexed
+//        by quantized error and error rate, so the cost is the same
+//        whatever the readings; only the small I term is computed here.
+//        The output is split across the motors around STEER_BASE_SPEED
+//        (lower = faster forward).
+// Args:  ping_num = 1 for the left wall, 2 for the right
+//        setpoint = range to hold from it (mm)
+// Retn:  None
+//------------------------------------------------------------------------
+{
+  uint16_t now = tickCount;
+  uint16_t dt;
+  int16_t error;
+  int32_t rate;
+  int8_t pd;
+  int32_t output;
+  int16_t delta;
+  PROFILE_START(PROFILE_CORRECTION);
+  
+  dt = now - wallSampleTick;
+  wallSampleTick = now;
+  if (ping_num == 1)
+  {
+    leftSampleReady = 0;
+  }
+  else
+  {
+    rightSampleReady = 0;
+  }
+  
+  //start from the range we are at and walk the target to the setpoint,
+  //so a new wall or setpoint never starts out with a saturated error
+  if (steerTarget == 0)
+  {
+    steerTarget = (int32_t)pinger[ping_num] << STEER_SLEW_SHIFT;
+  }
+  else
+  {
+    steerTarget += Clamp16(((int32_t)setpoint << STEER_SLEW_SHIFT) -
+                           steerTarget,
+                           dt > STEER_MAX_DT_TICKS ? STEER_MAX_DT_TICKS : dt);
+  }
+  
+  //positive error = steer left: too far from the left wall or too
+  //close to the right one
+  error = Clamp16((int32_t)pinger[ping_num] -
+                  (steerTarget >> STEER_SLEW_SHIFT), 0x7FFF);
+  if (ping_num == 2)
+  {
+    error = -error;
+  }
+  
+  if (!steerPrimed || dt == 0 || dt > STEER_MAX_DT_TICKS)
+  {
+    //no usable rate yet, start over from this sample
+    steerPrimed = 1;
+    steerPrevError = error;
+    steerIntegral = 0;
+    dt = 1;
+  }
+  
+  //error step times 1/dt gives the rate in 1/2^STEER_RATE_FRAC mm/tick
+  rate = ((int32_t)error - steerPrevError) * steerRecip[dt];
+  rate += 1L << (STEER_RECIP_SHIFT - STEER_RATE_FRAC - 1);
+  rate >>= STEER_RECIP_SHIFT - STEER_RATE_FRAC;
+  pd = steerLut[SteerBin(((int32_t)error + (1 << (STEER_ERR_SHIFT - 1)))
+                         >> STEER_ERR_SHIFT, STEER_ERR_BINS)]
+               [SteerBin(rate, STEER_RATE_BINS)];
+  steerPrevError = error;
+  
+  output = pd + ((STEER_KI_Q20 * steerIntegral) >> 20);
+  delta = Clamp16(output, STEER_MAX_DELTA);
+  
+  //only integrate while unsaturated so the integrator can't wind up
+  if (delta == output && pd != STEER_MAX_DELTA && pd != -STEER_MAX_DELTA)
+  {
+    steerIntegral += (int32_t)error * dt;
+    if (steerIntegral > STEER_I_LIMIT)
+    {
+      steerIntegral = STEER_I_LIMIT;
+    }
+    else if (steerIntegral < -STEER_I_LIMIT)
+    {
+      steerIntegral = -STEER_I_LIMIT;
+    }
+  }
+  
+  MotorRequest(0, STEER_BASE_SPEED - delta);  //right motor
+  MotorRequest(1, STEER_BASE_SPEED + delta);
+  
+  if (delta == 0)
+  {
+    HalLedOff(LED_RED | LED_GREEN);   // On the setpoint
+  }
+  PROFILE_STOP(PROFILE_CORRECTION);
+}
+
+void SteeringTask(void)
+//------------------------------------------------------------------------
+// Func:  Step the state machine once per tick on the latest readings.
+//        Ranging keeps running in every state, so any state can be
+//        left as soon as a reading calls for it.
+//------------------------------------------------------------------------
+{
+  uint16_t inState = tickCount - stateTick;
+  uint8_t frontSeen = (pinger[0] != 0 && EchoFresh(0));
+  uint16_t width = pinger[1] + pinger[2];
+  uint16_t lane;
+  
+  //force stop if we're to close, whatever we were doing
+  if (frontSeen && pinger[0] < STOP_RANGE_MM &&
+      CurrentState != STATE_STOP && CurrentState != STATE_BACKUP)
+  {
+    HallwayLogic(STATE_STOP);
+    return;
+  }
+  
+  switch (CurrentState)
+  {
+    case STATE_STOP:
+      if (inState >= STOP_HOLD_TICKS)
+      {
+        HallwayLogic(STATE_BACKUP);
+      }
+      break;
+    case STATE_BACKUP:
+      if (!frontSeen || pinger[0] >= BACKUP_CLEAR_MM)
+      {
+        stopCondition++;
+        HallwayLogic(STATE_FOLLOW);
+      }
+      else if (inState >= BACKUP_MAX_TICKS ||
+               (pinger[1] != 0 && pinger[1] < BACKUP_SIDE_MM && EchoFresh(1)) ||
+               (pinger[2] != 0 && pinger[2] < BACKUP_SIDE_MM && EchoFresh(2)))
+      {
+        //reversing into a wall or getting nowhere: dodge what is in
+        //front if there is room to turn, else stand
+        HallwayLogic(frontSeen && pinger[0] >= STOP_RANGE_MM ?
+                     STATE_DODGE : STATE_STOP);
+      }
+      break;
+    case STATE_DODGE:
+      //time the spin from when the motors actually have it
+      dodgeTurn += DodgeSpun();
+      if (frontSeen && pinger[0] < dodgeNear)
+      {
+        dodgeNear = pinger[0];
+      }
+      if (!frontSeen || (pinger[0] >= DODGE_RANGE_MM &&
+                         pinger[0] >= dodgeNear + DODGE_CLEAR_MM))
+      {
+        dodgeCondition++;
+        dodgeRight = (dodgeTurn > 0);
+        HallwayLogic(STATE_DODGE_CROSS);
+      }
+      else if (dodgeTurn >= DODGE_TURN_MAX_TICKS ||
+               dodgeTurn <= -DODGE_TURN_MAX_TICKS)
+      {
+        if (dodgeReversed)
+        {
+          HallwayLogic(STATE_STOP);     // Blocked both ways
+        }
+        else
+        {
+          //the obstacle reaches further this way than the walls said
+          dodgeReversed = 1;
+          dodgeNear = pinger[0];
+          DodgeSpin(dodgeTurn < 0);
+        }
+      }
+      break;
+    case STATE_DODGE_CROSS:
+      //both side ranges stretch by the same factor with the heading, so
+      //far * dodgeWidth / width is the square distance to the far wall.
+      //A steep crossing meets the far wall in front before the side
+      //range says we are there.
+      lane = dodgeRight ? pinger[2] : pinger[1];
+      if (width < dodgeWidth)
+      {
+        width = dodgeWidth;             // Near side sees the obstacle
+      }
+      if (inState >= DODGE_CROSS_TICKS ||
+          (frontSeen && pinger[0] < DODGE_WALL_MM) ||
+          (lane != 0 && (uint32_t)lane * dodgeWidth <=
+                        (uint32_t)DODGE_LANE_MM * width))
+      {
+        HallwayLogic(STATE_DODGE_SQUARE);
+      }
+      break;
+    case STATE_DODGE_SQUARE:
+      dodgeTurn += DodgeSpun();
+      if (dodgeRight ? dodgeTurn <= 0 : dodgeTurn >= 0)
+      {
+        HallwayLogic(STATE_DODGE_PASS);
+      }
+      break;
+    case STATE_DODGE_PASS:
+      //the side ranges fall short of the hallway while the obstacle is
+      //beside us, and add up again once it is behind
+      if (pinger[1] != 0 && pinger[2] != 0 &&
+          width + DODGE_FLANK_MM < dodgeWidth)
+      {
+        dodgeFlank = 1;
+      }
+      else if (inState >= DODGE_PASS_MAX_TICKS ||
+               (inState >= DODGE_PASS_TICKS && !dodgeFlank) ||
+               (dodgeFlank && width + DODGE_FLANK_MM / 2 >= dodgeWidth))
+      {
+        HallwayLogic(STATE_FOLLOW);     // Back to the left wall, PID reset
+        break;
+      }
+      if (dodgeRight && rightSampleReady)
+      {
+        CorrectionLogic(2, DODGE_LANE_MM);
+      }
+      else if (!dodgeRight && leftSampleReady)
+      {
+        CorrectionLogic(1, DODGE_LANE_MM);
+      }
+      break;
+    case STATE_TURN:
+      if (inState >= TURN_TICKS)
+      {
+        HallwayLogic(STATE_TURN_SETTLE);
+      }
+      break;
+    case STATE_TURN_SETTLE:
+      if (inState >= TURN_SETTLE_TICKS)
+      {
+        HallwayLogic(STATE_FOLLOW);
+      }
+      break;
+    case STATE_NOP:
+      //nothing moves before the Sabertooth is up, so the PID would
+      //only wind up on a standing robot
+      if (motorLinkUp)
+      {
+        HallwayLogic(STATE_FOLLOW);
+      }
+      break;
+    default:
+      /*
+      if (pinger[1] > TURN_OPEN_MM)
+      {
+        HallwayLogic(STATE_TURN);
+      }
+      else
+      */
+      //dodge, dodge, dodge
+      if (frontSeen && pinger[0] < DODGE_RANGE_MM)
+      {
+        HallwayLogic(STATE_DODGE);
+      }
+      else
+      {
+        CurrentState = STATE_FOLLOW;
+        if (leftSampleReady)
+        {
+          CorrectionLogic(1, STEER_SETPOINT);
+        }                             // else hold the last command
+      }
+      break;
+  }
+}
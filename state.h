@@ -0,0 +1,35 @@
+//------------------------------------------------------------------------
+// state.h - The hallway state machine and the wall-following
+//           controller. SteeringTask steps it once per tick on the
+//           latest ranges.
+//------------------------------------------------------------------------
+#ifndef STATE_H
+#define STATE_H
+
+#include "robot.h"
+
+#define STATE_PERIOD_TICKS 1          // State machine step
+
+#define STATE_NOP 0
+#define STATE_FOLLOW 1                // Wall following
+#define STATE_TURN 2                  // Timed turn into an opening
+#define STATE_STOP 3                  // Hold stopped
+#define STATE_DODGE 4                 // Spin away from a front obstacle
+#define STATE_BACKUP 5                // Reverse until the front clears
+#define STATE_TURN_SETTLE 6           // Coast after a turn
+#define STATE_DODGE_CROSS 7           // Cross to the free side after a dodge
+#define STATE_DODGE_SQUARE 8          // Spin back square
+#define STATE_DODGE_PASS 9            // Follow the far wall past the obstacle
+
+extern volatile uint8_t CurrentState;
+extern volatile uint8_t TurnCounter;
+extern volatile uint8_t stopCondition;
+extern volatile uint8_t dodgeCondition;
+extern volatile uint8_t leftSampleReady; // New left reading for the PID
+extern volatile uint8_t rightSampleReady; // New right reading for the PID
+
+void StateInit(void);
+void HallwayLogic(uint8_t StateMachine);
+void SteeringTask(void);
+
+#endif
@@ -0,0 +1,100 @@
+//------------------------------------------------------------------------
+// steer_lut.h - GENERATED by host/steer_lut_gen.c from steer_params.h.
+//               Do not edit; change steer_params.h and run make in host/.
+//------------------------------------------------------------------------
+#ifndef STEER_LUT_H
+#define STEER_LUT_H
+
+#include "steer_params.h"
+
+#if STEER_KP_Q10 != 116 || STEER_KD_Q10 != 70000 || STEER_MAX_DELTA != 20 \
+ || STEER_ERR_SHIFT != 2 || STEER_ERR_BINS != 64 \
+ || STEER_RATE_FRAC != 5 || STEER_RATE_BINS != 32 \
+ || STEER_RECIP_SHIFT != 12 || STEER_MAX_DT_TICKS != 100
+#error "steer_lut.h is stale, run make in host/"
+#endif
+
+static const int8_t steerLut[STEER_ERR_BINS][STEER_RATE_BINS] =
+{
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-12,-10, -8, -6, -4, -2,  0,  3,  5,  7,  9, 11, 13, 15, 18},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -6, -3, -1,  1,  3,  5,  7,  9, 12, 14, 16, 18},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-11, -9, -7, -5, -3, -1,  1,  3,  6,  8, 10, 12, 14, 16, 18},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-17,-15,-13,-11, -9, -7, -5, -2,  0,  2,  4,  6,  8, 10, 12, 15, 17, 19},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -8, -6, -4, -2,  0,  2,  4,  7,  9, 11, 13, 15, 17, 19},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-14,-12,-10, -8, -6, -4, -2,  1,  3,  5,  7,  9, 11, 13, 16, 18, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -5, -3, -1,  1,  3,  5,  7, 10, 12, 14, 16, 18, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-13,-11, -9, -7, -5, -3, -1,  1,  4,  6,  8, 10, 12, 14, 16, 19, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -7, -4, -2,  0,  2,  4,  6,  8, 10, 13, 15, 17, 19, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-10, -8, -6, -4, -2,  0,  2,  5,  7,  9, 11, 13, 15, 17, 19, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-16,-14,-12,-10, -8, -6, -4, -1,  1,  3,  5,  7,  9, 11, 14, 16, 18, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -7, -5, -3, -1,  1,  3,  5,  8, 10, 12, 14, 16, 18, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-15,-13,-11, -9, -7, -5, -3, -1,  2,  4,  6,  8, 10, 12, 14, 17, 19, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -6, -4, -2,  0,  2,  4,  6,  8, 11, 13, 15, 17, 19, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-12,-10, -8, -6, -4, -2,  0,  3,  5,  7,  9, 11, 13, 15, 17, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -6, -3, -1,  1,  3,  5,  7,  9, 12, 14, 16, 18, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12, -9, -7, -5, -3, -1,  1,  3,  6,  8, 10, 12, 14, 16, 18, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-17,-15,-13,-11, -9, -7, -5, -3,  0,  2,  4,  6,  8, 10, 12, 15, 17, 19, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -8, -6, -4, -2,  0,  2,  4,  6,  9, 11, 13, 15, 17, 19, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-14,-12,-10, -8, -6, -4, -2,  1,  3,  5,  7,  9, 11, 13, 15, 18, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -5, -3, -1,  1,  3,  5,  7, 10, 12, 14, 16, 18, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-11, -9, -7, -5, -3, -1,  1,  4,  6,  8, 10, 12, 14, 16, 19, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -7, -5, -2,  0,  2,  4,  6,  8, 10, 13, 15, 17, 19, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-10, -8, -6, -4, -2,  0,  2,  4,  7,  9, 11, 13, 15, 17, 19, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-19,-16,-14,-12,-10, -8, -6, -4, -1,  1,  3,  5,  7,  9, 11, 13, 16, 18, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -7, -5, -3, -1,  1,  3,  5,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-13,-11, -9, -7, -5, -3, -1,  2,  4,  6,  8, 10, 12, 14, 17, 19, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -7, -4, -2,  0,  2,  4,  6,  8, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-12,-10, -8, -6, -4, -2,  0,  2,  5,  7,  9, 11, 13, 15, 17, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -6, -3, -1,  1,  3,  5,  7,  9, 11, 14, 16, 18, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12, -9, -7, -5, -3, -1,  1,  3,  6,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-20,-18,-15,-13,-11, -9, -7, -5, -3,  0,  2,  4,  6,  8, 10, 12, 15, 17, 19, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -6, -4, -2,  0,  2,  4,  6,  9, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-19,-17,-15,-12,-10, -8, -6, -4, -2,  0,  3,  5,  7,  9, 11, 13, 15, 18, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -6, -3, -1,  1,  3,  5,  7,  9, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-18,-16,-14,-11, -9, -7, -5, -3, -1,  1,  3,  6,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-20,-17,-15,-13,-11, -9, -7, -5, -2,  0,  2,  4,  6,  8, 10, 12, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -8, -6, -4, -2,  0,  2,  4,  7,  9, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-19,-17,-14,-12,-10, -8, -6, -4, -2,  1,  3,  5,  7,  9, 11, 13, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -5, -3, -1,  1,  3,  5,  7, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-20,-18,-16,-13,-11, -9, -7, -5, -3, -1,  1,  4,  6,  8, 10, 12, 14, 16, 19, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -7, -4, -2,  0,  2,  4,  6,  8, 10, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-19,-17,-15,-13,-10, -8, -6, -4, -2,  0,  2,  5,  7,  9, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-19,-16,-14,-12,-10, -8, -6, -4, -1,  1,  3,  5,  7,  9, 11, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-18,-16,-14,-12,-10, -7, -5, -3, -1,  1,  3,  5,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-20,-18,-15,-13,-11, -9, -7, -5, -3, -1,  2,  4,  6,  8, 10, 12, 14, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-19,-17,-15,-13,-11, -9, -6, -4, -2,  0,  2,  4,  6,  8, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-19,-17,-15,-12,-10, -8, -6, -4, -2,  0,  3,  5,  7,  9, 11, 13, 15, 17, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-18,-16,-14,-12,-10, -8, -6, -3, -1,  1,  3,  5,  7,  9, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-18,-16,-14,-12, -9, -7, -5, -3, -1,  1,  3,  6,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-20,-17,-15,-13,-11, -9, -7, -5, -3,  0,  2,  4,  6,  8, 10, 12, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-19,-17,-15,-13,-11, -8, -6, -4, -2,  0,  2,  4,  6,  9, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-19,-17,-14,-12,-10, -8, -6, -4, -2,  1,  3,  5,  7,  9, 11, 13, 15, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-18,-16,-14,-12,-10, -8, -5, -3, -1,  1,  3,  5,  7, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-20,-18,-16,-14,-11, -9, -7, -5, -3, -1,  1,  4,  6,  8, 10, 12, 14, 16, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-19,-17,-15,-13,-11, -9, -7, -5, -2,  0,  2,  4,  6,  8, 10, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-19,-17,-15,-13,-10, -8, -6, -4, -2,  0,  2,  4,  7,  9, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-19,-16,-14,-12,-10, -8, -6, -4, -1,  1,  3,  5,  7,  9, 11, 13, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-18,-16,-14,-12,-10, -7, -5, -3, -1,  1,  3,  5,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-20,-18,-16,-13,-11, -9, -7, -5, -3, -1,  2,  4,  6,  8, 10, 12, 14, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-19,-17,-15,-13,-11, -9, -7, -4, -2,  0,  2,  4,  6,  8, 11, 13, 15, 17, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-19,-17,-15,-12,-10, -8, -6, -4, -2,  0,  2,  5,  7,  9, 11, 13, 15, 17, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-18,-16,-14,-12,-10, -8, -6, -3, -1,  1,  3,  5,  7,  9, 11, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20},
+  {-20,-18,-16,-14,-12, -9, -7, -5, -3, -1,  1,  3,  6,  8, 10, 12, 14, 16, 18, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20}
+};
+
+static const uint16_t steerRecip[STEER_MAX_DT_TICKS + 1] =
+{
+      0, 4096, 2048, 1365, 1024,  819,  683,  585,  512,  455,
+    410,  372,  341,  315,  293,  273,  256,  241,  228,  216,
+    205,  195,  186,  178,  171,  164,  158,  152,  146,  141,
+    137,  132,  128,  124,  120,  117,  114,  111,  108,  105,
+    102,  100,   98,   95,   93,   91,   89,   87,   85,   84,
+     82,   80,   79,   77,   76,   74,   73,   72,   71,   69,
+     68,   67,   66,   65,   64,   63,   62,   61,   60,   59,
+     59,   58,   57,   56,   55,   55,   54,   53,   53,   52,
+     51,   51,   50,   49,   49,   48,   48,   47,   47,   46,
+     46,   45,   45,   44,   44,   43,   43,   42,   42,   41,
+     41
+};
+
+#endif
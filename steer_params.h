@@ -0,0 +1,37 @@
+//------------------------------------------------------------------------
+// steer_params.h - Wall-following tuning. state.c reads it directly and
+//                  host/steer_lut_gen.c bakes it into steer_lut.h, so run
+//                  make in host/ after changing anything here.
+//------------------------------------------------------------------------
+#ifndef STEER_PARAMS_H
+#define STEER_PARAMS_H
+
+// CONTROLLER (left range in mm -> motor speed steps) //
+#ifndef STEER_SETPOINT
+#define STEER_SETPOINT 421            // Left wall range to hold (mm)
+#endif
+#ifndef STEER_BASE_SPEED
+#define STEER_BASE_SPEED 30           // Both motors when on the setpoint
+#endif
+#define STEER_MAX_DELTA 20            // Largest correction per motor
+#ifndef STEER_KP_Q10
+#define STEER_KP_Q10 116              // Steps per mm of error (Q10)
+#endif
+#ifndef STEER_KD_Q10
+#define STEER_KD_Q10 70000            // Steps per mm/tick of error rate (Q10)
+#endif
+#ifndef STEER_KI_Q20
+#define STEER_KI_Q20 6                // Steps per mm*tick of error (Q20)
+#endif
+#define STEER_I_LIMIT 3430000L        // Integrator clamp (mm*ticks)
+#define STEER_MAX_DT_TICKS 100        // Longer sample gaps restart the PID
+#define STEER_SLEW_SHIFT 4            // Setpoint walks 1 mm per 16 ticks
+
+// TABLE SHAPE //
+#define STEER_ERR_SHIFT 2             // 4 mm of error per bin
+#define STEER_ERR_BINS 64             // +-128 mm, clamped beyond
+#define STEER_RATE_FRAC 5             // 1/32 mm/tick of error rate per bin
+#define STEER_RATE_BINS 32            // +-0.5 mm/tick, clamped beyond
+#define STEER_RECIP_SHIFT 12          // 1/dt table is Q12
+
+#endif